@@ -0,0 +1,161 @@
+#include "Checkpointer.hpp"
+#include "Tracer.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Starts the writer thread.
+ * @param dir		directory periodic checkpoints are written to
+ * @param interval	steps between periodic checkpoints, 0 to only write on save()
+ */
+Checkpointer::Checkpointer(const std::string& dir, int interval) :
+	_dir(dir), _interval(interval), _lastStep(-1), _thread(&Checkpointer::run, this) {
+}
+
+/**
+ * @brief Writes whatever is still queued, then stops the writer thread.
+ */
+Checkpointer::~Checkpointer() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+	_thread.join();
+}
+
+/**
+ * @brief Takes a periodic checkpoint if at least interval steps passed since the last one.
+ *
+ * Call after stepping. The first call only records the current step, so resuming from a
+ * checkpoint does not immediately write it again.
+ *
+ * @return true if a checkpoint was taken
+ */
+bool Checkpointer::update(SimState& state) {
+	if(_interval <= 0) {
+		return false;
+	}
+	if(_lastStep < 0 || state.steps() < _lastStep) {
+		_lastStep = state.steps();
+		return false;
+	}
+	if(state.steps() - _lastStep < _interval) {
+		return false;
+	}
+
+	_lastStep = state.steps();
+	std::string path = _dir + "/checkpoint_" + std::to_string(state.steps()) + ".istate";
+	enqueue({state.snapshot(), path, true});
+	return true;
+}
+
+/**
+ * @brief Queues a one-off checkpoint of the current state.
+ */
+void Checkpointer::save(SimState& state, const std::string& path) {
+	enqueue({state.snapshot(), path, false});
+}
+
+void Checkpointer::enqueue(Job job) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if(job.periodic && !_jobs.empty() && _jobs.back().periodic) {
+			_jobs.back() = std::move(job);
+		} else {
+			_jobs.push_back(std::move(job));
+		}
+	}
+	_wake.notify_one();
+}
+
+/**
+ * @brief Blocks until every queued checkpoint is on disk.
+ */
+void Checkpointer::flush() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_drained.wait(lock, [this] { return _jobs.empty() && !_writing; });
+}
+
+/**
+ * @brief Checkpointer::lastWritten
+ * @return the path of the most recently completed checkpoint, empty if none
+ */
+std::string Checkpointer::lastWritten() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _lastWritten;
+}
+
+/**
+ * @brief Writes one checkpoint through a uniquely named temporary file, which is synced to disk
+ * and then renamed into place, so a crash during the write never leaves a truncated checkpoint
+ * behind. The temporary file is removed if anything fails.
+ */
+static bool writeCheckpoint(const SimState::Snapshot& snapshot, const std::string& path) {
+	std::string temp = path + ".XXXXXX";
+	int fd = mkstemp(&temp[0]);
+	if(fd < 0) {
+		return false;
+	}
+	fchmod(fd, 0644);	// mkstemp() creates it private
+
+	bool ok;
+	{
+		std::ofstream file(temp, std::ios::binary);
+		DataStream stream(file);
+		SimState::save(snapshot, stream);
+		file.close();
+		ok = stream.ok() && file;
+	}
+	// The rename is only safe once the data is on disk, or a crash could leave the new name
+	// pointing at an empty file.
+	ok = ok && fsync(fd) == 0;
+	close(fd);
+
+	if(!ok || std::rename(temp.c_str(), path.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Writer thread loop, see writeCheckpoint().
+ */
+void Checkpointer::run() {
+	Tracer::instance().setThreadName("checkpoint");
+
+	for(;;) {
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this] { return _stop || !_jobs.empty(); });
+			if(_jobs.empty()) {
+				return;
+			}
+			job = std::move(_jobs.front());
+			_jobs.pop_front();
+			_writing = true;
+		}
+
+		bool ok;
+		{
+			TRACE_SCOPE("checkpointWrite");
+			ok = writeCheckpoint(job.snapshot, job.path);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_writing = false;
+			if(ok) {
+				_lastWritten = job.path;
+			}
+		}
+		_drained.notify_all();
+	}
+}
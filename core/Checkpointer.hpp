@@ -0,0 +1,56 @@
+#ifndef CHECKPOINTER_HPP
+#define CHECKPOINTER_HPP
+
+#include "SimState.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Writes checkpoints of a running SimState on a background thread.
+ *
+ * The caller only pays for SimState::snapshot(); serialization and disk I/O happen on the
+ * writer thread. If the disk falls behind, a periodic checkpoint that has not started writing
+ * yet is replaced by the newer one instead of piling up in memory.
+ */
+class Checkpointer {
+	struct Job {
+		SimState::Snapshot snapshot;
+		std::string path;
+		bool periodic;
+	};
+
+	std::string _dir;
+	int _interval;
+	int _lastStep;
+
+	std::mutex _mutex;
+	std::condition_variable _wake;
+	std::condition_variable _drained;
+	std::deque<Job> _jobs;
+	bool _writing = false;
+	bool _stop = false;
+	std::string _lastWritten;
+	std::thread _thread;
+
+	void run();
+	void enqueue(Job job);
+
+public:
+	Checkpointer(const std::string& dir, int interval);
+	~Checkpointer();
+
+	Checkpointer(const Checkpointer&) = delete;
+	Checkpointer& operator=(const Checkpointer&) = delete;
+
+	bool update(SimState& state);
+	void save(SimState& state, const std::string& path);
+	void flush();
+
+	std::string lastWritten();
+};
+
+#endif // CHECKPOINTER_HPP
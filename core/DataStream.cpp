@@ -0,0 +1,125 @@
+#include "DataStream.hpp"
+
+#include <cstring>
+#include <iostream>
+
+DataStream::DataStream(std::istream& in) : _in(&in) {
+}
+
+DataStream::DataStream(std::ostream& out) : _out(&out) {
+}
+
+DataStream::DataStream(std::iostream& stream) : _in(&stream), _out(&stream) {
+}
+
+/**
+ * @brief False once a read ran past the end or a write failed.
+ */
+bool DataStream::ok() const {
+	return _ok;
+}
+
+/**
+ * @brief Marks the stream as failed, for data that was read but makes no sense.
+ */
+void DataStream::fail() {
+	_ok = false;
+}
+
+/**
+ * @brief Whether the next bytes of an input stream are the given ones, without consuming them.
+ * The stream has to be seekable, as files and string streams are.
+ */
+bool DataStream::startsWith(const std::string& bytes) {
+	if(!_in || !_ok) {
+		return false;
+	}
+
+	auto pos = _in->tellg();
+	std::string head(bytes.size(), '\0');
+	_in->read(&head[0], head.size());
+	bool match = _in->gcount() == (std::streamsize)head.size() && head == bytes;
+	_in->clear();
+	_in->seekg(pos);
+	return match;
+}
+
+void DataStream::write(const void* data, std::size_t size) {
+	if(!_out || !_ok) {
+		return;
+	}
+	_out->write((const char*)data, size);
+	_ok = (bool)*_out;
+}
+
+bool DataStream::read(void* data, std::size_t size) {
+	if(_in && _ok) {
+		_in->read((char*)data, size);
+		_ok = _in->gcount() == (std::streamsize)size;
+	}
+	if(!_ok) {
+		std::memset(data, 0, size);
+	}
+	return _ok;
+}
+
+DataStream& DataStream::operator<<(bool v) {
+	std::uint8_t b = v;
+	write(&b, 1);
+	return *this;
+}
+
+DataStream& DataStream::operator<<(std::int32_t v) {
+	return *this << (std::uint32_t)v;
+}
+
+DataStream& DataStream::operator<<(std::uint32_t v) {
+	std::uint8_t b[4] = {(std::uint8_t)(v >> 24), (std::uint8_t)(v >> 16), (std::uint8_t)(v >> 8), (std::uint8_t)v};
+	write(b, 4);
+	return *this;
+}
+
+DataStream& DataStream::operator<<(double v) {
+	std::uint64_t bits;
+	std::memcpy(&bits, &v, sizeof(bits));
+
+	std::uint8_t b[8];
+	for(int i = 0;i < 8;i++) {
+		b[i] = bits >> (56 - 8 * i);
+	}
+	write(b, 8);
+	return *this;
+}
+
+DataStream& DataStream::operator>>(bool& v) {
+	std::uint8_t b;
+	read(&b, 1);
+	v = b != 0;
+	return *this;
+}
+
+DataStream& DataStream::operator>>(std::int32_t& v) {
+	std::uint32_t u;
+	*this >> u;
+	v = (std::int32_t)u;
+	return *this;
+}
+
+DataStream& DataStream::operator>>(std::uint32_t& v) {
+	std::uint8_t b[4];
+	read(b, 4);
+	v = (std::uint32_t)b[0] << 24 | (std::uint32_t)b[1] << 16 | (std::uint32_t)b[2] << 8 | b[3];
+	return *this;
+}
+
+DataStream& DataStream::operator>>(double& v) {
+	std::uint8_t b[8];
+	read(b, 8);
+
+	std::uint64_t bits = 0;
+	for(int i = 0;i < 8;i++) {
+		bits = bits << 8 | b[i];
+	}
+	std::memcpy(&v, &bits, sizeof(v));
+	return *this;
+}
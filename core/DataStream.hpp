@@ -0,0 +1,44 @@
+#ifndef DATA_STREAM_HPP
+#define DATA_STREAM_HPP
+
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/**
+ * Reads and writes the binary encoding QDataStream uses for the types in .istate files, on
+ * standard streams: integers and doubles big-endian, bool as one byte. Files written before the
+ * core stopped depending on Qt load unchanged, and the other way around.
+ *
+ * Like QDataStream, a failed read or write is sticky: ok() turns false and later reads return
+ * zeros.
+ */
+class DataStream {
+	std::istream* _in = nullptr;
+	std::ostream* _out = nullptr;
+	bool _ok = true;
+
+	void write(const void* data, std::size_t size);
+	bool read(void* data, std::size_t size);
+
+public:
+	explicit DataStream(std::istream& in);
+	explicit DataStream(std::ostream& out);
+	explicit DataStream(std::iostream& stream);
+
+	bool ok() const;
+	void fail();
+	bool startsWith(const std::string& bytes);
+
+	DataStream& operator<<(bool v);
+	DataStream& operator<<(std::int32_t v);
+	DataStream& operator<<(std::uint32_t v);
+	DataStream& operator<<(double v);
+
+	DataStream& operator>>(bool& v);
+	DataStream& operator>>(std::int32_t& v);
+	DataStream& operator>>(std::uint32_t& v);
+	DataStream& operator>>(double& v);
+};
+
+#endif // DATA_STREAM_HPP
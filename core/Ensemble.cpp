@@ -0,0 +1,277 @@
+#include "Ensemble.hpp"
+#include "Lattice.hpp"
+#include "Profiler.hpp"
+
+#include <cassert>
+
+using namespace lattice;
+
+static constexpr double four9ths = 4.0/9.0;
+static constexpr double one9th   = 1.0/9.0;
+static constexpr double one36th  = 1.0/36.0;
+
+/**
+ * @brief Creates an ensemble on the geometry of a state, one member per (viscosity, u0) pair.
+ *
+ * The barrier array is shared with the geometry state and must not be edited afterwards. Members
+ * always collide with BGK and use the forced in-flow with periodic edges, whatever the geometry
+ * state uses.
+ */
+Ensemble::Ensemble(const SimState& geometry, const std::vector<double>& viscosities, const std::vector<double>& u0s) :
+	height(geometry.height),
+	width(geometry.width),
+	members(viscosities.size()),
+	barrier(geometry.barrier),
+	u0(u0s)
+{
+	assert(viscosities.size() == u0s.size());
+
+	for(double viscosity : viscosities) {
+		omega.push_back(1 / (3*viscosity + 0.5));
+	}
+
+	// Same order SimState::stream() visits barriers in, so bounce-back matches it exactly.
+	for(int row = 0;row < height;row++) {
+		for(int col = 0;col < width;col++) {
+			if(barrier[row * width + col]) {
+				barrierCells.push_back(col * height + row);
+			}
+		}
+	}
+
+	size_t n = (size_t)height * width * members;
+	for(auto& d : f) {
+		d.resize(n);
+	}
+	scratch.resize(n);
+	rho.resize(n);
+	_ux.resize(n);
+	_uy.resize(n);
+
+	for(size_t cell = 0;cell < (size_t)height * width;cell++) {
+		for(int m = 0;m < members;m++) {
+			double u = u0[m];
+			size_t i = cell * members + m;
+			f[D0][i]  = four9ths * (1 - 1.5*u*u);
+			f[DN][i]  = one9th * (1 - 1.5*u*u);
+			f[DS][i]  = one9th * (1 - 1.5*u*u);
+			f[DE][i]  = one9th * (1 + 3*u + 4.5*u*u - 1.5*u*u);
+			f[DW][i]  = one9th * (1 - 3*u + 4.5*u*u - 1.5*u*u);
+			f[DNE][i] = one36th * (1 + 3*u + 4.5*u*u - 1.5*u*u);
+			f[DSE][i] = one36th * (1 + 3*u + 4.5*u*u - 1.5*u*u);
+			f[DNW][i] = one36th * (1 - 3*u + 4.5*u*u - 1.5*u*u);
+			f[DSW][i] = one36th * (1 - 3*u + 4.5*u*u - 1.5*u*u);
+
+			double r = 0;
+			for(int d = 0;d < 9;d++) {
+				r += f[d][i];
+			}
+			rho[i] = r;
+			_ux[i] = (f[DE][i] + f[DNE][i] + f[DSE][i] - f[DW][i] - f[DNW][i] - f[DSW][i]) / r;
+			_uy[i] = (f[DN][i] + f[DNE][i] + f[DNW][i] - f[DS][i] - f[DSE][i] - f[DSW][i]) / r;
+		}
+	}
+}
+
+/**
+ * @brief Steps every member once.
+ */
+void Ensemble::step() {
+	PROFILE_SCOPE_CELLS("ensemble", (long)height * width * members);
+
+	stream();
+	collide();
+	_steps++;
+}
+
+/**
+ * @brief Ensemble::steps
+ * @return the number of steps taken
+ */
+int Ensemble::steps() {
+	return _steps;
+}
+
+/**
+ * @brief Ensemble::size
+ * @return the number of members
+ */
+int Ensemble::size() {
+	return members;
+}
+
+/**
+ * @brief Moves populations to their neighbours (periodic) and bounces them back off barriers.
+ */
+void Ensemble::stream() {
+	const int M = members;
+
+	for(int d = 1;d < 9;d++) {
+		double* __restrict__ out = scratch.data();
+		const double* __restrict__ in = f[d].data();
+
+		for(int col = 0;col < width;col++) {
+			int srcCol = (col - dCol[d] + width) % width;
+			for(int row = 0;row < height;row++) {
+				int srcRow = (row - dRow[d] + height) % height;
+				double* __restrict__ o = out + ((size_t)col * height + row) * M;
+				const double* __restrict__ s = in + ((size_t)srcCol * height + srcRow) * M;
+				for(int m = 0;m < M;m++) {
+					o[m] = s[m];
+				}
+			}
+		}
+
+		f[d].swap(scratch);
+	}
+
+	for(int cell : barrierCells) {
+		int row = cell % height;
+		int col = cell / height;
+
+		for(int d = 1;d < 9;d++) {
+			int r = row - dRow[d];
+			int c = col - dCol[d];
+			if(r < 0 || r >= height || c < 0 || c >= width) {
+				continue;
+			}
+
+			double* __restrict__ o = f[opposite[d]].data() + ((size_t)c * height + r) * M;
+			const double* __restrict__ s = f[d].data() + (size_t)cell * M;
+			for(int m = 0;m < M;m++) {
+				o[m] = s[m];
+			}
+		}
+	}
+}
+
+/**
+ * @brief Relaxes every member towards equilibrium and forces the in-flow on column 0.
+ */
+void Ensemble::collide() {
+	const int M = members;
+	const size_t cells = (size_t)height * width;
+
+	double* __restrict__ n0  = f[D0].data();
+	double* __restrict__ nN  = f[DN].data();
+	double* __restrict__ nS  = f[DS].data();
+	double* __restrict__ nE  = f[DE].data();
+	double* __restrict__ nW  = f[DW].data();
+	double* __restrict__ nNE = f[DNE].data();
+	double* __restrict__ nSE = f[DSE].data();
+	double* __restrict__ nNW = f[DNW].data();
+	double* __restrict__ nSW = f[DSW].data();
+	double* __restrict__ r   = rho.data();
+	double* __restrict__ ux  = _ux.data();
+	double* __restrict__ uy  = _uy.data();
+	const double* __restrict__ w = omega.data();
+
+	for(size_t cell = 0;cell < cells;cell++) {
+		size_t base = cell * M;
+		for(int m = 0;m < M;m++) {
+			size_t i = base + m;
+			double density = n0[i] + nN[i] + nS[i] + nE[i] + nW[i] + nNE[i] + nSE[i] + nNW[i] + nSW[i];
+			double vx = (nE[i] + nNE[i] + nSE[i] - nW[i] - nNW[i] - nSW[i]) / density;
+			double vy = (nN[i] + nNE[i] + nNW[i] - nS[i] - nSE[i] - nSW[i]) / density;
+			r[i] = density;
+			ux[i] = vx;
+			uy[i] = vy;
+
+			double ux2 = vx * vx;
+			double uy2 = vy * vy;
+			double u2 = ux2 + uy2;
+			double omu215 = 1 - 1.5*u2;
+			double uxuy = vx * vy;
+			double om = w[m];
+
+			n0[i]  = (1-om)*n0[i]  + om * four9ths * density * omu215;
+			nN[i]  = (1-om)*nN[i]  + om * one9th * density * (omu215 + 3*vy + 4.5*uy2);
+			nS[i]  = (1-om)*nS[i]  + om * one9th * density * (omu215 - 3*vy + 4.5*uy2);
+			nE[i]  = (1-om)*nE[i]  + om * one9th * density * (omu215 + 3*vx + 4.5*ux2);
+			nW[i]  = (1-om)*nW[i]  + om * one9th * density * (omu215 - 3*vx + 4.5*ux2);
+			nNE[i] = (1-om)*nNE[i] + om * one36th * density * (omu215 + 3*(vx+vy) + 4.5*(u2+2*uxuy));
+			nNW[i] = (1-om)*nNW[i] + om * one36th * density * (omu215 + 3*(-vx+vy) + 4.5*(u2-2*uxuy));
+			nSE[i] = (1-om)*nSE[i] + om * one36th * density * (omu215 + 3*(vx-vy) + 4.5*(u2-2*uxuy));
+			nSW[i] = (1-om)*nSW[i] + om * one36th * density * (omu215 + 3*(-vx-vy) + 4.5*(u2+2*uxuy));
+		}
+	}
+
+	// Force steady rightward flow at ends (no need to set 0, N, and S components). Column 0 is
+	// the first height cells of the column-major layout.
+	for(int row = 0;row < height;row++) {
+		size_t base = (size_t)row * M;
+		for(int m = 0;m < M;m++) {
+			double u = u0[m];
+			nE[base + m]  = one9th * (1 + 3*u + 4.5*u*u - 1.5*u*u);
+			nW[base + m]  = one9th * (1 - 3*u + 4.5*u*u - 1.5*u*u);
+			nNE[base + m] = one36th * (1 + 3*u + 4.5*u*u - 1.5*u*u);
+			nSE[base + m] = one36th * (1 + 3*u + 4.5*u*u - 1.5*u*u);
+			nNW[base + m] = one36th * (1 - 3*u + 4.5*u*u - 1.5*u*u);
+			nSW[base + m] = one36th * (1 - 3*u + 4.5*u*u - 1.5*u*u);
+		}
+	}
+}
+
+/**
+ * @brief Copies one member's lane of an interleaved field into a matrix.
+ */
+arma::mat Ensemble::field(const std::vector<double>& data, int member) {
+	arma::mat out(height, width);
+	for(arma::uword i = 0;i < out.n_elem;i++) {
+		out[i] = data[i * members + member];
+	}
+	return out;
+}
+
+arma::mat Ensemble::ux(int member) {
+	return field(_ux, member);
+}
+
+arma::mat Ensemble::uy(int member) {
+	return field(_uy, member);
+}
+
+arma::mat Ensemble::density(int member) {
+	return field(rho, member);
+}
+
+/**
+ * @brief Ensemble::getFrame
+ * @return the current frame of one member
+ */
+Frame Ensemble::getFrame(int member) {
+	return Frame(height, width, barrier, ux(member), uy(member), density(member));
+}
+
+/**
+ * @brief Extracts one member as a stand-alone state, e.g. to save it or keep stepping it alone.
+ */
+SimState Ensemble::state(int member) {
+	SimState s(height, width, 0.0, u0[member]);
+	s.omega = omega[member];
+	s.barrier = barrier;
+	s._solidCells.clear();
+	for(int row = 0;row < height;row++) {
+		for(int col = 0;col < width;col++) {
+			if(barrier[row * width + col]) {
+				s._solidCells.push_back(row * width + col);
+			}
+		}
+	}
+	s.started = _steps > 0;
+	s._steps = _steps;
+
+	arma::mat* n[9] = {&s.n0, &s.nN, &s.nS, &s.nE, &s.nW, &s.nNE, &s.nSE, &s.nNW, &s.nSW};
+	for(int d = 0;d < 9;d++) {
+		*n[d] = field(f[d], member);
+	}
+	FrameFields& fields = s.writeFields(false);
+	fields.density = density(member);
+	fields.ux = ux(member);
+	fields.uy = uy(member);
+
+	s.frames.clear();
+	s.pushFrame(Frame(height, width, barrier, s._fields));
+
+	return s;
+}
@@ -0,0 +1,60 @@
+#ifndef ENSEMBLE_HPP
+#define ENSEMBLE_HPP
+
+#include "Frame.hpp"
+#include "SimState.hpp"
+
+#include <armadillo>
+
+#include <boost/shared_array.hpp>
+
+#include <vector>
+
+/**
+ * Many same-shaped simulations stepped together, for ensembles of small domains.
+ *
+ * Populations are stored with the member index innermost (cell * members + member), so every
+ * loop of the stream-collide kernel runs across members on contiguous memory and vectorizes,
+ * one member per SIMD lane. Members share the barrier geometry but each has its own omega and u0.
+ * Numerically each member follows SimState::step() exactly.
+ */
+class Ensemble {
+	int height;
+	int width;
+	int members;
+
+	boost::shared_array<bool> barrier;
+	std::vector<int> barrierCells;		// linear indices (col * height + row) in row-major order
+
+	std::vector<double> omega;
+	std::vector<double> u0;
+
+	std::vector<double> f[9];			// populations: 0, N, S, E, W, NE, SE, NW, SW
+	std::vector<double> scratch;
+	std::vector<double> rho;
+	std::vector<double> _ux;
+	std::vector<double> _uy;
+
+	int _steps = 0;
+
+	void stream();
+	void collide();
+
+	arma::mat field(const std::vector<double>& data, int member);
+
+public:
+	Ensemble(const SimState& geometry, const std::vector<double>& viscosities, const std::vector<double>& u0s);
+
+	void step();
+	int steps();
+	int size();
+
+	arma::mat ux(int member);
+	arma::mat uy(int member);
+	arma::mat density(int member);
+	Frame getFrame(int member);
+
+	SimState state(int member);
+};
+
+#endif // ENSEMBLE_HPP
@@ -0,0 +1,35 @@
+#ifndef FLUID_CORE_HPP
+#define FLUID_CORE_HPP
+
+/**
+ * Public headers of libfluidcore, the solver without Qt. Programs embedding it include this and
+ * link -lfluidcore (plus -lpthread -lrt).
+ *
+ * FLUIDCORE_VERSION_MAJOR changes whenever a declaration in these headers changes incompatibly;
+ * the .istate format is versioned on its own, see SimState::FILE_VERSION.
+ */
+
+#define FLUIDCORE_VERSION_MAJOR 4
+#define FLUIDCORE_VERSION_MINOR 0
+
+#include "Checkpointer.hpp"
+#include "DataStream.hpp"
+#include "Ensemble.hpp"
+#include "Frame.hpp"
+#include "FramePool.hpp"
+#include "FrameRing.hpp"
+#include "FrameServer.hpp"
+#include "Geometry.hpp"
+#include "MomentLattice.hpp"
+#include "MultiBlock.hpp"
+#include "Obstacle.hpp"
+#include "PageBuffer.hpp"
+#include "Profiler.hpp"
+#include "Shape.hpp"
+#include "ShiftedLattice.hpp"
+#include "SimState.hpp"
+#include "Sweep.hpp"
+#include "Tracer.hpp"
+#include "Tuner.hpp"
+
+#endif // FLUID_CORE_HPP
@@ -0,0 +1,96 @@
+#include "Frame.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+static std::uint64_t nextId() {
+	static std::atomic<std::uint64_t> counter(0);
+	return ++counter;
+}
+
+/**
+ * @brief Builds a frame from copies of the given fields, in a buffer from FramePool.
+ */
+Frame::Frame(int height, int width,
+			 const boost::shared_array<const bool> barriers,
+			 const arma::mat& ux,
+			 const arma::mat& uy,
+			 const arma::mat& density) :
+    barriers(barriers), id(nextId()), height(height), width(width) {
+	assert(ux.n_rows == (arma::uword)height && ux.n_cols == (arma::uword)width);
+	assert(uy.n_rows == (arma::uword)height && uy.n_cols == (arma::uword)width);
+	assert(density.n_rows == (arma::uword)height && density.n_cols == (arma::uword)width);
+
+	auto buffer = FramePool::instance().acquire(height, width);
+	buffer->ux = ux;
+	buffer->uy = uy;
+	buffer->density = density;
+	fields = buffer;
+}
+
+/**
+ * @brief Builds a frame on fields that are not changed any more, without copying them.
+ */
+Frame::Frame(int height, int width,
+			 const boost::shared_array<const bool> barriers,
+			 const std::shared_ptr<const FrameFields>& fields) :
+	barriers(barriers), fields(fields), id(nextId()), height(height), width(width) {
+	assert(fields->ux.n_rows == (arma::uword)height && fields->ux.n_cols == (arma::uword)width);
+}
+
+const arma::mat& Frame::ux() const {
+	return fields->ux;
+}
+
+const arma::mat& Frame::uy() const {
+	return fields->uy;
+}
+
+const arma::mat& Frame::density() const {
+	return fields->density;
+}
+
+bool Frame::getBarrier(int row, int col) const {
+	int i = row * width + col;
+	if(barriers[i]) {
+		return true;
+	}
+	return overlay && std::binary_search(overlay->begin(), overlay->end(), i);
+}
+
+/**
+ * @brief Points the frame at a different barrier array of the same size.
+ */
+void Frame::setBarriers(const boost::shared_array<const bool>& barriers) {
+	this->barriers = barriers;
+}
+
+/**
+ * @brief Marks cells covered by moving obstacles on top of the static barriers.
+ * @param overlay	sorted row-major cell indices, or null for none
+ */
+void Frame::setOverlay(const std::shared_ptr<const std::vector<int>>& overlay) {
+	this->overlay = overlay;
+}
+
+Frame Frame::getSubframe(int row, int col, int height, int width) {
+    PROFILE_SCOPE("subframe");
+
+    assert(row + height < this->height);
+    assert(col + width < this->width);
+
+    boost::shared_array<bool> new_barriers(new bool[height * width]);
+
+    for(int i = 0;i < height;i++) {
+        for(int j = 0;j < width;j++) {
+            new_barriers[i * width + j] = getBarrier(row + i, col + j);
+        }
+    }
+
+    return Frame(height, width, new_barriers,
+                 ux().submat(row, col, row + height - 1, col + width - 1),
+                 uy().submat(row, col, row + height - 1, col + width - 1),
+                 density().submat(row, col, row + height - 1, col + width - 1));
+}
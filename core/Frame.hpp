@@ -0,0 +1,59 @@
+#ifndef VEC_FIELD_HPP
+#define VEC_FIELD_HPP
+
+#include "FramePool.hpp"
+
+#include <armadillo>
+
+#include <boost/shared_array.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * Represents a vector field.
+ *
+ * The fields are held in a shared, read-only FrameFields buffer, so copying a frame, or taking
+ * one of a SimState, copies no field data.
+ */
+class Frame {
+	boost::shared_array<const bool> barriers;
+
+	// Cells covered by moving obstacles at this frame's step, sorted row-major indices. Shared
+	// between frames while the obstacles' footprint does not change.
+	std::shared_ptr<const std::vector<int>> overlay;
+
+	std::shared_ptr<const FrameFields> fields;
+
+public:
+	// Identifies the field data. Copies share the id and so does a frame whose barriers were
+	// edited; any newly constructed frame gets a fresh one.
+	std::uint64_t id;
+	int height;
+	int width;
+
+	const arma::mat& ux() const;
+	const arma::mat& uy() const;
+	const arma::mat& density() const;
+
+	bool getBarrier(int row, int col) const;
+	void setBarriers(const boost::shared_array<const bool>& barriers);
+	void setOverlay(const std::shared_ptr<const std::vector<int>>& overlay);
+    Frame getSubframe(int row, int col, int height, int width);
+
+	Frame(int height, int width,
+		  const boost::shared_array<const bool> barriers,
+		  const arma::mat& ux,
+		  const arma::mat& uy,
+		  const arma::mat& density);
+	Frame(int height, int width,
+		  const boost::shared_array<const bool> barriers,
+		  const std::shared_ptr<const FrameFields>& fields);
+
+	// Leave the default copy constructor.
+	Frame(const Frame&) = default;
+	Frame& operator=(const Frame&) = default;
+};
+
+#endif // VEC_FIELD_HPP
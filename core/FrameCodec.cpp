@@ -0,0 +1,267 @@
+#include "FrameCodec.hpp"
+
+#include <cstring>
+
+/**
+ * @brief The value of a cell, undoing the quantization.
+ * @param field	which field
+ * @param i		row-major cell index
+ */
+float QuantizedFrame::value(Field field, int i) const {
+	return min[field] + (max[field] - min[field]) * values[field][i] / 65535.0f;
+}
+
+namespace {
+
+void put8(std::vector<std::uint8_t>& out, std::uint8_t v) {
+	out.push_back(v);
+}
+
+void put16(std::vector<std::uint8_t>& out, std::uint16_t v) {
+	out.push_back(v >> 8);
+	out.push_back(v);
+}
+
+void put32(std::vector<std::uint8_t>& out, std::uint32_t v) {
+	out.push_back(v >> 24);
+	out.push_back(v >> 16);
+	out.push_back(v >> 8);
+	out.push_back(v);
+}
+
+void putFloat(std::vector<std::uint8_t>& out, float v) {
+	std::uint32_t bits;
+	std::memcpy(&bits, &v, sizeof(bits));
+	put32(out, bits);
+}
+
+void putVarint(std::vector<std::uint8_t>& out, std::uint32_t v) {
+	while(v >= 0x80) {
+		out.push_back((v & 0x7F) | 0x80);
+		v >>= 7;
+	}
+	out.push_back(v);
+}
+
+std::uint32_t zigzag(std::int32_t v) {
+	return ((std::uint32_t)v << 1) ^ (std::uint32_t)(v >> 31);
+}
+
+std::int32_t unzigzag(std::uint32_t v) {
+	return (std::int32_t)(v >> 1) ^ -(std::int32_t)(v & 1);
+}
+
+/**
+ * Reads from a message, failing instead of running past its end.
+ */
+struct Reader {
+	const std::uint8_t* data;
+	std::size_t size;
+	std::size_t pos = 0;
+	bool ok = true;
+
+	Reader(const std::uint8_t* data, std::size_t size) : data(data), size(size) {}
+
+	std::uint32_t get(int bytes) {
+		if(pos + bytes > size) {
+			ok = false;
+			return 0;
+		}
+		std::uint32_t v = 0;
+		for(int i = 0;i < bytes;i++) {
+			v = (v << 8) | data[pos++];
+		}
+		return v;
+	}
+
+	float getFloat() {
+		std::uint32_t bits = get(4);
+		float v;
+		std::memcpy(&v, &bits, sizeof(v));
+		return v;
+	}
+
+	std::uint32_t getVarint() {
+		std::uint32_t v = 0;
+		for(int shift = 0;shift < 35;shift += 7) {
+			if(pos >= size) {
+				break;
+			}
+			std::uint8_t b = data[pos++];
+			v |= (std::uint32_t)(b & 0x7F) << shift;
+			if(!(b & 0x80)) {
+				return v;
+			}
+		}
+		ok = false;
+		return 0;
+	}
+};
+
+}
+
+/**
+ * @brief Appends one message to a buffer.
+ * @param frame		the frame to send
+ * @param previous	the frame last sent on the connection, or null to send a key frame; ignored
+ *					if its size differs
+ * @param out		buffer the message is appended to
+ */
+void FrameCodec::encode(const QuantizedFrame& frame, const QuantizedFrame* previous, std::vector<std::uint8_t>& out) {
+	if(previous && (previous->height != frame.height || previous->width != frame.width)) {
+		previous = nullptr;
+	}
+
+	std::size_t start = out.size();
+	put32(out, MAGIC);
+	put32(out, 0);
+	put8(out, VERSION);
+	put8(out, previous ? 0 : KEY);
+	put32(out, frame.step);
+	put16(out, frame.factor);
+	put32(out, frame.height);
+	put32(out, frame.width);
+	for(int f = 0;f < QuantizedFrame::FIELDS;f++) {
+		putFloat(out, frame.min[f]);
+		putFloat(out, frame.max[f]);
+	}
+
+	int cells = frame.height * frame.width;
+	for(int f = 0;f < QuantizedFrame::FIELDS;f++) {
+		const std::uint16_t* values = frame.values[f].data();
+		const std::uint16_t* reference = previous ? previous->values[f].data() : nullptr;
+		std::int32_t last = 0;
+		std::uint32_t zeros = 0;
+		for(int i = 0;i < cells;i++) {
+			std::int32_t base = reference ? reference[i] : last;
+			std::int32_t delta = (std::int32_t)values[i] - base;
+			last = values[i];
+
+			if(delta == 0) {
+				zeros++;
+				continue;
+			}
+			if(zeros > 0) {
+				putVarint(out, 0);
+				putVarint(out, zeros - 1);
+				zeros = 0;
+			}
+			putVarint(out, zigzag(delta));
+		}
+		if(zeros > 0) {
+			putVarint(out, 0);
+			putVarint(out, zeros - 1);
+		}
+	}
+
+	std::uint8_t current = 0;
+	std::uint32_t run = 0;
+	for(int i = 0;i < cells;i++) {
+		if(frame.barriers[i] != current) {
+			putVarint(out, run);
+			current = frame.barriers[i];
+			run = 0;
+		}
+		run++;
+	}
+	putVarint(out, run);
+
+	std::uint32_t length = out.size() - start - HEADER;
+	for(int i = 0;i < 4;i++) {
+		out[start + 4 + i] = length >> (24 - 8 * i);
+	}
+}
+
+/**
+ * @brief The size of the first message in a buffer, once its header has arrived.
+ * @return the size including the header, or 0 if fewer than HEADER bytes are available
+ */
+std::size_t FrameCodec::messageSize(const std::uint8_t* data, std::size_t size) {
+	if(size < HEADER) {
+		return 0;
+	}
+	Reader reader(data + 4, 4);
+	return HEADER + reader.get(4);
+}
+
+/**
+ * @brief Decodes one complete message.
+ * @param previous	the frame decoded from the previous message on the connection, needed unless
+ *					this is a key frame
+ * @return false if the message is malformed or needs a previous frame it was not given
+ */
+bool FrameCodec::decode(const std::uint8_t* data, std::size_t size, const QuantizedFrame* previous, QuantizedFrame& frame) {
+	Reader reader(data, size);
+	if(reader.get(4) != MAGIC) {
+		return false;
+	}
+	reader.get(4);
+	if(reader.get(1) != VERSION) {
+		return false;
+	}
+	bool key = reader.get(1) & KEY;
+	frame.step = reader.get(4);
+	frame.factor = reader.get(2);
+	std::size_t height = reader.get(4);
+	std::size_t width = reader.get(4);
+	for(int f = 0;f < QuantizedFrame::FIELDS;f++) {
+		frame.min[f] = reader.getFloat();
+		frame.max[f] = reader.getFloat();
+	}
+
+	// Both sides are at most 2^32 - 1, so the product is checked by division, not computed.
+	if(!reader.ok || height == 0 || width == 0 || height > MAX_CELLS / width) {
+		return false;
+	}
+	std::size_t cells = height * width;
+	// Runs of unchanged cells cost two bytes per 2^14, which bounds the allocation below.
+	if(cells > size * 8192) {
+		return false;
+	}
+	frame.height = height;
+	frame.width = width;
+	if(!key && (!previous || previous->height != frame.height || previous->width != frame.width)) {
+		return false;
+	}
+
+	for(int f = 0;f < QuantizedFrame::FIELDS;f++) {
+		std::vector<std::uint16_t> values(cells);
+		std::int32_t last = 0;
+		std::size_t zeros = 0;
+		for(std::size_t i = 0;i < cells;i++) {
+			std::int32_t base = key ? last : previous->values[f][i];
+			std::int32_t delta = 0;
+			if(zeros > 0) {
+				zeros--;
+			} else {
+				std::uint32_t token = reader.getVarint();
+				if(token == 0) {
+					zeros = reader.getVarint();
+				} else {
+					delta = unzigzag(token);
+				}
+			}
+			last = base + delta;
+			values[i] = last;
+		}
+		if(zeros > 0 || !reader.ok) {
+			return false;
+		}
+		frame.values[f].swap(values);
+	}
+
+	frame.barriers.assign(cells, 0);
+	std::uint8_t current = 0;
+	std::size_t i = 0;
+	while(i < cells && reader.ok) {
+		std::uint32_t run = reader.getVarint();
+		if(run > cells - i) {
+			return false;
+		}
+		std::memset(&frame.barriers[i], current, run);
+		i += run;
+		current ^= 1;
+	}
+
+	return reader.ok;
+}
@@ -0,0 +1,54 @@
+#ifndef FRAME_CODEC_HPP
+#define FRAME_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * A frame as sent to remote viewers. Each field is quantized to 16 bits over its own range in
+ * that frame; cells are stored row-major.
+ */
+struct QuantizedFrame {
+	enum Field {UX, UY, DENSITY, FIELDS};
+
+	std::uint32_t step = 0;
+	int height = 0;
+	int width = 0;
+
+	// Cells of the simulation averaged into each cell of this frame, per side.
+	int factor = 1;
+
+	float min[FIELDS] = {0, 0, 0};
+	float max[FIELDS] = {0, 0, 0};
+	std::vector<std::uint16_t> values[FIELDS];
+	std::vector<std::uint8_t> barriers;
+
+	float value(Field field, int i) const;
+};
+
+/**
+ * Wire format of the frame stream. Every message is
+ *
+ *	u32 magic "LBMF", u32 length of the rest, u8 version, u8 flags, u32 step, u16 factor,
+ *	u32 height, u32 width, 3 x (f32 min, f32 max), the values, the barriers
+ *
+ * with fixed-size integers big-endian. The values of the three fields follow each other as
+ * differences: against the same cell of the previous message on the connection, or against the
+ * previous cell of the same field in a key frame (flag KEY). A nonzero difference is a zigzag
+ * varint; a run of n zero differences is a 0 followed by the varint n - 1. The barriers are
+ * varint run lengths, alternating fluid and solid and starting with fluid.
+ */
+namespace FrameCodec {
+	static constexpr std::uint32_t MAGIC = 0x4C424D46; // "LBMF"
+	static constexpr std::uint8_t VERSION = 1;
+	static constexpr std::uint8_t KEY = 1;
+	static constexpr std::size_t HEADER = 8;
+	static constexpr std::size_t MAX_CELLS = std::size_t(1) << 28;	// largest frame decode() accepts
+
+	void encode(const QuantizedFrame& frame, const QuantizedFrame* previous, std::vector<std::uint8_t>& out);
+	std::size_t messageSize(const std::uint8_t* data, std::size_t size);
+	bool decode(const std::uint8_t* data, std::size_t size, const QuantizedFrame* previous, QuantizedFrame& frame);
+}
+
+#endif // FRAME_CODEC_HPP
@@ -0,0 +1,140 @@
+#include "FramePool.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+/**
+ * @brief FramePool::instance
+ * @return the process-wide pool frames and simulations take field buffers from
+ */
+FramePool& FramePool::instance() {
+	static FramePool pool;
+	return pool;
+}
+
+/**
+ * @brief The buffers of a shape, created if new. Call with the mutex held.
+ */
+FramePool::Shape& FramePool::find(arma::uword rows, arma::uword cols) {
+	for(Shape& shape : _shapes) {
+		if(shape.rows == rows && shape.cols == cols) {
+			shape.lastUse = ++_clock;
+			return shape;
+		}
+	}
+
+	if((int)_shapes.size() >= MAX_SHAPES) {
+		// Free what the shape used longest ago keeps, e.g. that of a closed simulation.
+		auto oldest = std::min_element(_shapes.begin(), _shapes.end(), [](const Shape& a, const Shape& b) {
+			return a.lastUse < b.lastUse;
+		});
+		trim(*oldest, 0);
+		if(oldest->buffers.empty()) {
+			_shapes.erase(oldest);
+		}
+	}
+	_shapes.push_back(Shape{rows, cols, ++_clock, {}});
+	_shapes.back().buffers.reserve(_capacity);
+	return _shapes.back();
+}
+
+/**
+ * @brief Drops free buffers of a shape until at most keep are left; buffers still in use stay.
+ * Call with the mutex held.
+ */
+void FramePool::trim(Shape& shape, int keep) {
+	auto& buffers = shape.buffers;
+	for(size_t i = buffers.size();i-- > 0 && (int)buffers.size() > keep;) {
+		if(buffers[i].use_count() == 1) {
+			buffers.erase(buffers.begin() + i);
+		}
+	}
+}
+
+/**
+ * @brief A rows x cols buffer nobody else holds, a recycled one if there is any. The contents
+ * are undefined.
+ */
+std::shared_ptr<FrameFields> FramePool::acquire(int rows, int cols) {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Shape& shape = find(rows, cols);
+		// Only the pool can hand out a buffer it holds alone, so a count of 1 cannot go up
+		// behind our back.
+		for(auto& buffer : shape.buffers) {
+			if(buffer.use_count() == 1) {
+				// Pairs with the release of the last frame that read it.
+				std::atomic_thread_fence(std::memory_order_acquire);
+				_hits++;
+				return buffer;
+			}
+		}
+		_misses++;
+	}
+
+	auto buffer = std::make_shared<FrameFields>();
+	buffer->ux.set_size(rows, cols);
+	buffer->uy.set_size(rows, cols);
+	buffer->density.set_size(rows, cols);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	Shape& shape = find(rows, cols);
+	if((int)shape.buffers.size() < _capacity) {
+		buffer->pooled = true;
+		shape.buffers.push_back(buffer);
+	}
+	return buffer;
+}
+
+/**
+ * @brief Whether anyone but the caller and the pool holds a buffer, i.e. whether the caller must
+ * leave it unchanged. Frames are only ever copied from frames, so once this is false it stays
+ * false until the caller shares the buffer again.
+ */
+bool FramePool::shared(const std::shared_ptr<FrameFields>& fields) {
+	return fields.use_count() > (fields->pooled ? 2 : 1);
+}
+
+/**
+ * @brief Sets how many buffers are kept per shape (16 by default). Free buffers beyond it are
+ * freed now, buffers in use by the next clear().
+ */
+void FramePool::setCapacity(int buffers) {
+	std::lock_guard<std::mutex> lock(_mutex);
+	_capacity = std::max(buffers, 0);
+	for(Shape& shape : _shapes) {
+		trim(shape, _capacity);
+		shape.buffers.reserve(_capacity);
+	}
+}
+
+/**
+ * @brief Frees every buffer nobody uses.
+ */
+void FramePool::clear() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	for(Shape& shape : _shapes) {
+		trim(shape, 0);
+	}
+	_shapes.erase(std::remove_if(_shapes.begin(), _shapes.end(), [](const Shape& shape) {
+		return shape.buffers.empty();
+	}), _shapes.end());
+}
+
+/**
+ * @brief FramePool::hits
+ * @return how many buffers were handed out again
+ */
+std::uint64_t FramePool::hits() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _hits;
+}
+
+/**
+ * @brief FramePool::misses
+ * @return how many buffers had to be allocated
+ */
+std::uint64_t FramePool::misses() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _misses;
+}
@@ -0,0 +1,64 @@
+#ifndef FRAME_POOL_HPP
+#define FRAME_POOL_HPP
+
+#include <armadillo>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * The macroscopic fields of one step, shared read-only between a simulation and the frames
+ * taken of it. Whoever wants to change shared fields writes a fresh buffer instead.
+ */
+struct FrameFields {
+	arma::mat ux;
+	arma::mat uy;
+	arma::mat density;
+
+	bool pooled = false;	// FramePool holds a reference for as long as anyone else does
+};
+
+/**
+ * Recycles field buffers.
+ *
+ * A running simulation needs a fresh buffer each step while frames still hold the last one,
+ * and with a frame limit drops a frame per step, all of the same shape. The pool keeps the
+ * buffers it handed out; one whose only owner left is the pool is free again, so stepping at a
+ * steady frame count does not touch the heap. Buffers are kept per shape, a bounded number of
+ * each; the pool only lets go of a buffer once it is free, e.g. of shapes not used recently.
+ */
+class FramePool {
+	struct Shape {
+		arma::uword rows;
+		arma::uword cols;
+		std::uint64_t lastUse;
+		std::vector<std::shared_ptr<FrameFields>> buffers;
+	};
+
+	std::mutex _mutex;
+	std::vector<Shape> _shapes;
+	std::uint64_t _clock = 0;
+	int _capacity = 16;				// buffers kept per shape
+	std::uint64_t _hits = 0;
+	std::uint64_t _misses = 0;
+
+	static constexpr int MAX_SHAPES = 4;
+
+	Shape& find(arma::uword rows, arma::uword cols);
+	void trim(Shape& shape, int keep);
+
+public:
+	static FramePool& instance();
+
+	std::shared_ptr<FrameFields> acquire(int rows, int cols);
+	static bool shared(const std::shared_ptr<FrameFields>& fields);
+
+	void setCapacity(int buffers);
+	void clear();
+	std::uint64_t hits();
+	std::uint64_t misses();
+};
+
+#endif // FRAME_POOL_HPP
@@ -0,0 +1,296 @@
+#include "FrameRing.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <climits>
+#include <cstring>
+#include <new>
+
+using namespace FrameRingLayout;
+
+static constexpr std::size_t ALIGNMENT = 64;
+
+static std::size_t align(std::size_t n) {
+	return (n + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+}
+
+FrameRing::~FrameRing() {
+	close();
+}
+
+/**
+ * @brief Creates the shared segment, replacing any left over under the same name.
+ * @param name		POSIX shared memory name, e.g. "/lbm"
+ * @param height	rows of the frames that will be published
+ * @param width		columns of the frames that will be published
+ * @param slots		frames kept; more give slow readers longer before a slot is reused
+ * @return false if the segment could not be created
+ */
+bool FrameRing::create(const std::string& name, int height, int width, int slots) {
+	close();
+
+	std::size_t cells = (std::size_t)height * width;
+	std::size_t uxOffset = align(sizeof(Slot));
+	std::size_t uyOffset = uxOffset + align(cells * sizeof(double));
+	std::size_t densityOffset = uyOffset + align(cells * sizeof(double));
+	std::size_t barrierOffset = densityOffset + align(cells * sizeof(double));
+	std::size_t slotSize = barrierOffset + align(cells);
+	std::size_t size = align(sizeof(Header)) + slots * slotSize;
+
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if(fd < 0) {
+		return false;
+	}
+	if(ftruncate(fd, size) < 0) {
+		::close(fd);
+		shm_unlink(name.c_str());
+		return false;
+	}
+	void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(memory == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		return false;
+	}
+
+	_name = name;
+	_height = height;
+	_width = width;
+	_memory = memory;
+	_size = size;
+
+	// The segment starts zeroed, so every slot reads as never written.
+	_header = new(memory) Header();
+	_header->height = height;
+	_header->width = width;
+	_header->slots = slots;
+	_header->slotSize = slotSize;
+	_header->uxOffset = uxOffset;
+	_header->uyOffset = uyOffset;
+	_header->densityOffset = densityOffset;
+	_header->barrierOffset = barrierOffset;
+	_header->published.store(0, std::memory_order_relaxed);
+	for(int i = 0;i < slots;i++) {
+		auto slot = new((char*)memory + align(sizeof(Header)) + i * slotSize) Slot();
+		slot->sequence.store(0, std::memory_order_relaxed);
+	}
+
+	// Readers check the magic last, after everything else is in place.
+	_header->version = VERSION;
+	std::atomic_thread_fence(std::memory_order_release);
+	_header->magic = MAGIC;
+	return true;
+}
+
+/**
+ * @brief Unmaps and removes the segment. Readers that still have it mapped keep their mapping.
+ */
+void FrameRing::close() {
+	if(!_memory) {
+		return;
+	}
+	munmap(_memory, _size);
+	shm_unlink(_name.c_str());
+	_memory = nullptr;
+	_header = nullptr;
+}
+
+const std::string& FrameRing::name() const {
+	return _name;
+}
+
+/**
+ * @brief Copies one frame into the next slot. Never blocks on readers.
+ * @param ux, uy, density	column-major fields of height x width cells
+ * @param barriers			row-major static barriers, as SimState keeps them
+ * @param overlay			sorted row-major cells additionally covered by moving obstacles
+ */
+void FrameRing::publish(std::uint64_t step, const double* ux, const double* uy, const double* density,
+						const bool* barriers, const std::vector<int>* overlay) {
+	if(!_header) {
+		return;
+	}
+
+	std::uint64_t n = _header->published.load(std::memory_order_relaxed) + 1;
+	char* base = (char*)_memory + align(sizeof(Header)) + (n - 1) % _header->slots * _header->slotSize;
+	Slot* slot = (Slot*)base;
+
+	slot->sequence.store(2 * n - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	std::size_t cells = (std::size_t)_height * _width;
+	slot->step = step;
+	std::memcpy(base + _header->uxOffset, ux, cells * sizeof(double));
+	std::memcpy(base + _header->uyOffset, uy, cells * sizeof(double));
+	std::memcpy(base + _header->densityOffset, density, cells * sizeof(double));
+
+	std::uint8_t* mask = (std::uint8_t*)(base + _header->barrierOffset);
+	for(int col = 0;col < _width;col++) {
+		for(int row = 0;row < _height;row++) {
+			*mask++ = barriers[row * _width + col];
+		}
+	}
+	if(overlay) {
+		mask = (std::uint8_t*)(base + _header->barrierOffset);
+		for(int i : *overlay) {
+			mask[(i % _width) * _height + i / _width] = 1;
+		}
+	}
+
+	slot->sequence.store(2 * n, std::memory_order_release);
+	_header->published.store(n, std::memory_order_release);
+}
+
+FrameRingReader::~FrameRingReader() {
+	close();
+}
+
+/**
+ * @brief Whether the slots a header describes fit in a segment of the given size and each one
+ * holds its fields, so a damaged or foreign segment cannot send reads out of bounds.
+ */
+static bool validLayout(const Header& header, std::uint64_t size) {
+	std::uint64_t slotSize = header.slotSize;
+	if(header.slots == 0 || slotSize < sizeof(Slot) || slotSize % ALIGNMENT != 0
+			|| header.slots > (size - align(sizeof(Header))) / slotSize) {
+		return false;
+	}
+	if(header.height == 0 || header.width == 0 || header.height > INT_MAX || header.width > INT_MAX) {
+		return false;
+	}
+
+	std::uint64_t cells = (std::uint64_t)header.height * header.width;
+	if(cells > slotSize) {
+		return false;
+	}
+	auto fits = [&](std::uint64_t offset, std::uint64_t bytes, std::uint64_t alignment) {
+		return offset >= sizeof(Slot) && offset % alignment == 0 && offset <= slotSize
+			   && bytes <= slotSize - offset;
+	};
+	return fits(header.uxOffset, cells * sizeof(double), alignof(double))
+		   && fits(header.uyOffset, cells * sizeof(double), alignof(double))
+		   && fits(header.densityOffset, cells * sizeof(double), alignof(double))
+		   && fits(header.barrierOffset, cells, 1);
+}
+
+/**
+ * @brief Maps a segment created by FrameRing::create(), read-only.
+ * @return false if it does not exist, is not a frame ring of this version or its layout does not
+ * fit the segment
+ */
+bool FrameRingReader::open(const std::string& name) {
+	close();
+
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if(fd < 0) {
+		return false;
+	}
+	struct stat st;
+	if(fstat(fd, &st) < 0 || (std::size_t)st.st_size < sizeof(Header)) {
+		::close(fd);
+		return false;
+	}
+	void* memory = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd);
+	if(memory == MAP_FAILED) {
+		return false;
+	}
+
+	auto header = (const Header*)memory;
+	bool ok = header->magic == MAGIC;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	ok = ok && header->version == VERSION && validLayout(*header, st.st_size);
+	if(!ok) {
+		munmap(memory, st.st_size);
+		return false;
+	}
+
+	_memory = memory;
+	_size = st.st_size;
+	_header = header;
+	return true;
+}
+
+void FrameRingReader::close() {
+	if(!_memory) {
+		return;
+	}
+	munmap(_memory, _size);
+	_memory = nullptr;
+	_header = nullptr;
+}
+
+int FrameRingReader::height() const {
+	return _header->height;
+}
+
+int FrameRingReader::width() const {
+	return _header->width;
+}
+
+int FrameRingReader::slots() const {
+	return _header->slots;
+}
+
+/**
+ * @brief Number of the newest complete publication, 0 before the first.
+ */
+std::uint64_t FrameRingReader::published() const {
+	return _header->published.load(std::memory_order_acquire);
+}
+
+const Slot* FrameRingReader::slot(std::uint64_t publication) const {
+	return (const Slot*)((const char*)_memory + align(sizeof(Header)) +
+						 (publication - 1) % _header->slots * _header->slotSize);
+}
+
+/**
+ * @brief Points a view at a publication, without copying.
+ *
+ * The view stays usable until the producer wraps around to its slot again; call valid() after
+ * using the data and discard the results if it returns false.
+ *
+ * @return false if that publication is not (or no longer) in the ring
+ */
+bool FrameRingReader::read(std::uint64_t publication, View& view) const {
+	if(publication == 0) {
+		return false;
+	}
+
+	const Slot* s = slot(publication);
+	if(s->sequence.load(std::memory_order_acquire) != 2 * publication) {
+		return false;
+	}
+
+	const char* base = (const char*)s;
+	view.publication = publication;
+	view.step = s->step;
+	view.ux = (const double*)(base + _header->uxOffset);
+	view.uy = (const double*)(base + _header->uyOffset);
+	view.density = (const double*)(base + _header->densityOffset);
+	view.barriers = (const std::uint8_t*)(base + _header->barrierOffset);
+
+	// The step is read outside the sequence check above.
+	return valid(view);
+}
+
+/**
+ * @brief Points a view at the newest publication.
+ * @return false if nothing was published yet, or the producer lapped the reader while it looked
+ */
+bool FrameRingReader::latest(View& view) const {
+	return read(published(), view);
+}
+
+/**
+ * @brief Whether the slot of a view still holds its publication, so everything read through the
+ * view so far is consistent.
+ */
+bool FrameRingReader::valid(const View& view) const {
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return slot(view.publication)->sequence.load(std::memory_order_relaxed) == 2 * view.publication;
+}
@@ -0,0 +1,117 @@
+#ifndef FRAME_RING_HPP
+#define FRAME_RING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * A ring of frames in POSIX shared memory, written by one simulation and read in place by any
+ * number of other processes.
+ *
+ * The segment starts with a Header, followed by `slots` slots of `slotSize` bytes. A slot is a
+ * Slot header followed by ux, uy and density as doubles and the barrier mask as bytes, each at
+ * the offset given in the Header and all column-major (cell = col * height + row), like the
+ * fields of Frame.
+ *
+ * Publication n (counting from 1) goes to slot (n - 1) % slots. Each slot is a seqlock: its
+ * sequence is 2n - 1 while publication n is being written and 2n once it is complete. The
+ * producer never waits for readers; a reader checks the sequence again after using a slot and
+ * discards what it read if the slot was overwritten in the meantime.
+ */
+namespace FrameRingLayout {
+	static constexpr std::uint32_t MAGIC = 0x4C424D52; // "LBMR"
+	static constexpr std::uint32_t VERSION = 1;
+
+	struct Header {
+		std::uint32_t magic;
+		std::uint32_t version;
+		std::uint32_t height;
+		std::uint32_t width;
+		std::uint32_t slots;
+		std::uint32_t reserved;
+		std::uint64_t slotSize;
+		std::uint64_t uxOffset;
+		std::uint64_t uyOffset;
+		std::uint64_t densityOffset;
+		std::uint64_t barrierOffset;
+
+		// Number of the newest complete publication, 0 before the first.
+		alignas(64) std::atomic<std::uint64_t> published;
+	};
+
+	struct alignas(64) Slot {
+		std::atomic<std::uint64_t> sequence;
+		std::uint64_t step;
+	};
+}
+
+/**
+ * The producer side of a frame ring. Creates the segment and removes it again when destroyed.
+ */
+class FrameRing {
+	std::string _name;
+	int _height = 0;
+	int _width = 0;
+	void* _memory = nullptr;
+	std::size_t _size = 0;
+	FrameRingLayout::Header* _header = nullptr;
+
+public:
+	FrameRing() = default;
+	~FrameRing();
+
+	FrameRing(const FrameRing&) = delete;
+	FrameRing& operator=(const FrameRing&) = delete;
+
+	bool create(const std::string& name, int height, int width, int slots = 8);
+	void close();
+	const std::string& name() const;
+
+	void publish(std::uint64_t step, const double* ux, const double* uy, const double* density,
+				 const bool* barriers, const std::vector<int>* overlay = nullptr);
+};
+
+/**
+ * The consumer side of a frame ring. Views point straight into the shared segment; nothing is
+ * copied.
+ */
+class FrameRingReader {
+	void* _memory = nullptr;
+	std::size_t _size = 0;
+	const FrameRingLayout::Header* _header = nullptr;
+
+	const FrameRingLayout::Slot* slot(std::uint64_t publication) const;
+
+public:
+	struct View {
+		std::uint64_t publication = 0;
+		std::uint64_t step = 0;
+		const double* ux = nullptr;
+		const double* uy = nullptr;
+		const double* density = nullptr;
+		const std::uint8_t* barriers = nullptr;
+	};
+
+	FrameRingReader() = default;
+	~FrameRingReader();
+
+	FrameRingReader(const FrameRingReader&) = delete;
+	FrameRingReader& operator=(const FrameRingReader&) = delete;
+
+	bool open(const std::string& name);
+	void close();
+
+	int height() const;
+	int width() const;
+	int slots() const;
+	std::uint64_t published() const;
+
+	bool read(std::uint64_t publication, View& view) const;
+	bool latest(View& view) const;
+	bool valid(const View& view) const;
+};
+
+#endif // FRAME_RING_HPP
@@ -0,0 +1,330 @@
+#include "FrameServer.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+
+/**
+ * @param factor	cells averaged into one per side before sending, 1 to send every cell
+ * @param maxFps	most frames per second wants() lets through
+ */
+FrameServer::FrameServer(int factor, double maxFps) :
+	_factor(std::max(factor, 1)), _maxFps(maxFps), _clients(0), _sent(0), _dropped(0) {
+}
+
+FrameServer::~FrameServer() {
+	stop();
+}
+
+/**
+ * @brief Starts listening and the sending thread.
+ * @param port		TCP port, 0 to pick a free one (see port())
+ * @param address	IPv4 address to listen on; the default only accepts local viewers
+ * @return false if the socket could not be set up
+ */
+bool FrameServer::start(int port, const std::string& address) {
+	if(_thread.joinable()) {
+		return false;
+	}
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	if(inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1) {
+		return false;
+	}
+
+	_listenFd = socket(AF_INET, SOCK_STREAM, 0);
+	if(_listenFd < 0) {
+		return false;
+	}
+	int yes = 1;
+	setsockopt(_listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+	socklen_t length = sizeof(addr);
+	if(bind(_listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 ||
+	   listen(_listenFd, 8) < 0 ||
+	   getsockname(_listenFd, (sockaddr*)&addr, &length) < 0 ||
+	   pipe(_wakeFds) < 0) {
+		close(_listenFd);
+		_listenFd = -1;
+		return false;
+	}
+	_port = ntohs(addr.sin_port);
+
+	fcntl(_listenFd, F_SETFL, O_NONBLOCK);
+	fcntl(_wakeFds[0], F_SETFL, O_NONBLOCK);
+	fcntl(_wakeFds[1], F_SETFL, O_NONBLOCK);
+
+	_stop = false;
+	_thread = std::thread(&FrameServer::run, this);
+	return true;
+}
+
+/**
+ * @brief Disconnects every viewer and stops listening.
+ */
+void FrameServer::stop() {
+	if(!_thread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	wake();
+	_thread.join();
+
+	close(_listenFd);
+	close(_wakeFds[0]);
+	close(_wakeFds[1]);
+	_listenFd = -1;
+	_wakeFds[0] = _wakeFds[1] = -1;
+	_clients = 0;
+}
+
+/**
+ * @brief The port being listened on.
+ */
+int FrameServer::port() const {
+	return _port;
+}
+
+void FrameServer::wake() {
+	char c = 0;
+	ssize_t r = write(_wakeFds[1], &c, 1);
+	(void)r; // A full pipe already has a wakeup pending.
+}
+
+/**
+ * @brief Whether a frame published now would be sent anywhere. Lets callers skip building a
+ * frame when nobody is watching or the frame rate cap was already reached.
+ */
+bool FrameServer::wants() {
+	if(_clients == 0) {
+		return false;
+	}
+	double now = Profiler::instance().now();
+	return _lastPublish < 0 || now - _lastPublish >= 1 / _maxFps;
+}
+
+/**
+ * @brief Makes a frame the newest one, replacing any that has not been sent yet.
+ * @param step	step number of the frame
+ */
+void FrameServer::publish(int step, const Frame& frame) {
+	TRACE_SCOPE("publish");
+
+	_lastPublish = Profiler::instance().now();
+
+	auto q = std::make_shared<QuantizedFrame>();
+	q->step = step;
+	q->factor = _factor;
+	q->height = (frame.height + _factor - 1) / _factor;
+	q->width = (frame.width + _factor - 1) / _factor;
+
+	int cells = q->height * q->width;
+	std::vector<float> averages[QuantizedFrame::FIELDS];
+	for(auto& a : averages) {
+		a.assign(cells, 0);
+	}
+	std::vector<int> counts(cells, 0);
+	std::vector<int> solid(cells, 0);
+
+	// Fields are column-major; the frame is sent row-major.
+	const arma::mat* fields[QuantizedFrame::FIELDS] = {&frame.ux(), &frame.uy(), &frame.density()};
+	for(int col = 0;col < frame.width;col++) {
+		for(int row = 0;row < frame.height;row++) {
+			int i = (row / _factor) * q->width + col / _factor;
+			for(int f = 0;f < QuantizedFrame::FIELDS;f++) {
+				averages[f][i] += fields[f]->at(row, col);
+			}
+			counts[i]++;
+			solid[i] += frame.getBarrier(row, col);
+		}
+	}
+
+	q->barriers.resize(cells);
+	for(int i = 0;i < cells;i++) {
+		q->barriers[i] = 2 * solid[i] > counts[i];
+	}
+
+	for(int f = 0;f < QuantizedFrame::FIELDS;f++) {
+		auto& a = averages[f];
+		for(int i = 0;i < cells;i++) {
+			a[i] /= counts[i];
+		}
+		auto range = std::minmax_element(a.begin(), a.end());
+		float low = *range.first;
+		float high = *range.second;
+
+		// Widen the range with a margin when the values leave it, and narrow it again once
+		// they only use a small part of it.
+		float span = _max[f] - _min[f];
+		if(!_haveRange || low < _min[f] || high > _max[f] || 4 * (high - low) < span) {
+			float margin = (high - low) / 8;
+			_min[f] = low - margin;
+			_max[f] = high + margin;
+		}
+		q->min[f] = _min[f];
+		q->max[f] = _max[f];
+
+		float scale = q->max[f] > q->min[f] ? 65535 / (q->max[f] - q->min[f]) : 0;
+		q->values[f].resize(cells);
+		for(int i = 0;i < cells;i++) {
+			q->values[f][i] = std::lround((a[i] - q->min[f]) * scale);
+		}
+	}
+
+	_haveRange = true;
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_latest = q;
+		_published++;
+	}
+	wake();
+}
+
+/**
+ * @brief Accepts viewers and sends them the newest frame whenever they are ready for one.
+ */
+void FrameServer::run() {
+	Tracer::instance().setThreadName("frame server");
+
+	std::vector<Client> clients;
+	std::vector<pollfd> fds;
+
+	while(true) {
+		std::shared_ptr<const QuantizedFrame> latest;
+		long published;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if(_stop) {
+				break;
+			}
+			latest = _latest;
+			published = _published;
+		}
+
+		// Clients that finished their last message get the newest frame. Any frames published
+		// while they were busy are skipped.
+		for(auto& c : clients) {
+			if(c.sent == c.out.size() && latest && published != c.published) {
+				if(c.reference) {
+					_dropped += published - c.published - 1;
+				}
+				c.published = published;
+				c.out.clear();
+				c.sent = 0;
+				FrameCodec::encode(*latest, c.reference.get(), c.out);
+				c.reference = latest;
+			}
+		}
+
+		fds.clear();
+		fds.push_back({_listenFd, POLLIN, 0});
+		fds.push_back({_wakeFds[0], POLLIN, 0});
+		for(auto& c : clients) {
+			// Readable only matters to notice the viewer hanging up.
+			short events = c.sent < c.out.size() ? POLLOUT | POLLIN : POLLIN;
+			fds.push_back({c.fd, events, 0});
+		}
+
+		if(poll(fds.data(), fds.size(), -1) < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		if(fds[1].revents & POLLIN) {
+			char buffer[64];
+			while(read(_wakeFds[0], buffer, sizeof(buffer)) > 0) {
+			}
+		}
+
+		for(std::size_t i = 0;i < clients.size();i++) {
+			Client& c = clients[i];
+			short revents = fds[i + 2].revents;
+			bool closed = revents & (POLLERR | POLLHUP | POLLNVAL);
+
+			if(!closed && (revents & POLLIN)) {
+				char buffer[256];
+				ssize_t n = recv(c.fd, buffer, sizeof(buffer), 0);
+				closed = n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+			}
+
+			if(!closed && (revents & POLLOUT)) {
+				ssize_t n = send(c.fd, c.out.data() + c.sent, c.out.size() - c.sent, MSG_NOSIGNAL);
+				if(n > 0) {
+					c.sent += n;
+					if(c.sent == c.out.size()) {
+						_sent++;
+					}
+				} else if(n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+					closed = true;
+				}
+			}
+
+			if(closed) {
+				close(c.fd);
+				c.fd = -1;
+			}
+		}
+		clients.erase(std::remove_if(clients.begin(), clients.end(),
+									 [](const Client& c) { return c.fd < 0; }),
+					  clients.end());
+
+		if(fds[0].revents & POLLIN) {
+			int fd;
+			while((fd = accept(_listenFd, nullptr, nullptr)) >= 0) {
+				fcntl(fd, F_SETFL, O_NONBLOCK);
+				int yes = 1;
+				setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+				Client c;
+				c.fd = fd;
+				clients.push_back(std::move(c));
+			}
+		}
+
+		_clients = clients.size();
+	}
+
+	for(auto& c : clients) {
+		close(c.fd);
+	}
+}
+
+/**
+ * @brief The number of connected viewers.
+ */
+int FrameServer::clients() const {
+	return _clients;
+}
+
+/**
+ * @brief Messages completely sent, over all viewers.
+ */
+long FrameServer::sent() const {
+	return _sent;
+}
+
+/**
+ * @brief Published frames skipped by viewers that were still receiving an older one, summed
+ * over all viewers.
+ */
+long FrameServer::dropped() const {
+	return _dropped;
+}
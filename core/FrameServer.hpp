@@ -0,0 +1,78 @@
+#ifndef FRAME_SERVER_HPP
+#define FRAME_SERVER_HPP
+
+#include "Frame.hpp"
+#include "FrameCodec.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Publishes frames to remote viewers over TCP, in the format of FrameCodec.
+ *
+ * publish() quantizes (and optionally downsamples) a frame on the caller's thread; a background
+ * thread encodes it for every client against what that client last received and sends it without
+ * blocking. A client that is still receiving an older message skips every frame published in the
+ * meantime and gets the newest one next, so slow viewers never hold back the simulation or the
+ * other viewers.
+ */
+class FrameServer {
+	struct Client {
+		int fd;
+		std::vector<std::uint8_t> out;
+		std::size_t sent = 0;
+		std::shared_ptr<const QuantizedFrame> reference;
+		long published = 0;
+	};
+
+	int _factor;
+	double _maxFps;
+
+	int _listenFd = -1;
+	int _wakeFds[2] = {-1, -1};
+	int _port = 0;
+
+	std::mutex _mutex;
+	std::shared_ptr<const QuantizedFrame> _latest;
+	long _published = 0;
+	bool _stop = false;
+	std::thread _thread;
+
+	std::atomic<int> _clients;
+	std::atomic<long> _sent;
+	std::atomic<long> _dropped;
+	double _lastPublish = -1;
+
+	// Quantization range of each field, kept while the values fit so that consecutive frames
+	// quantize alike and their deltas stay small.
+	float _min[QuantizedFrame::FIELDS];
+	float _max[QuantizedFrame::FIELDS];
+	bool _haveRange = false;
+
+	void run();
+	void wake();
+
+public:
+	FrameServer(int factor = 1, double maxFps = 30);
+	~FrameServer();
+
+	FrameServer(const FrameServer&) = delete;
+	FrameServer& operator=(const FrameServer&) = delete;
+
+	bool start(int port, const std::string& address = "127.0.0.1");
+	void stop();
+	int port() const;
+
+	bool wants();
+	void publish(int step, const Frame& frame);
+
+	int clients() const;
+	long sent() const;
+	long dropped() const;
+};
+
+#endif // FRAME_SERVER_HPP
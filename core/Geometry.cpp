@@ -0,0 +1,109 @@
+#include "Geometry.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+Geometry::Geometry(int rows, int cols) : rows(rows), cols(cols), mask(rows * cols, 0) {
+}
+
+/**
+ * @brief Covers a rectangle of cells, clipped to the grid.
+ */
+void Geometry::rectangle(int row, int col, int height, int width) {
+	int r0 = std::max(row, 0);
+	int r1 = std::min(row + height, rows);
+	int c0 = std::max(col, 0);
+	int c1 = std::min(col + width, cols);
+
+	for(int r = r0;r < r1;r++) {
+		std::fill(mask.begin() + r * cols + c0, mask.begin() + r * cols + std::max(c0, c1), 1);
+	}
+}
+
+/**
+ * @brief Covers every cell whose center is within radius of (row, col).
+ */
+void Geometry::circle(double row, double col, double radius) {
+	capsule(row, col, row, col, radius);
+}
+
+/**
+ * @brief Covers a line through the given (row, col) points.
+ * @param thickness	width of the line in cells
+ */
+void Geometry::polyline(const std::vector<std::pair<double, double>>& points, double thickness) {
+	for(size_t i = 0;i + 1 < points.size();i++) {
+		capsule(points[i].first, points[i].second, points[i + 1].first, points[i + 1].second, thickness / 2);
+	}
+	if(points.size() == 1) {
+		circle(points[0].first, points[0].second, thickness / 2);
+	}
+}
+
+/**
+ * @brief Covers the cells within radius of the segment from (r0, c0) to (r1, c1).
+ */
+void Geometry::capsule(double r0, double c0, double r1, double c1, double radius) {
+	int rowMin = std::max(0, (int)std::floor(std::min(r0, r1) - radius));
+	int rowMax = std::min(rows - 1, (int)std::ceil(std::max(r0, r1) + radius));
+	int colMin = std::max(0, (int)std::floor(std::min(c0, c1) - radius));
+	int colMax = std::min(cols - 1, (int)std::ceil(std::max(c0, c1) + radius));
+
+	double dr = r1 - r0;
+	double dc = c1 - c0;
+	double length2 = dr*dr + dc*dc;
+
+	for(int r = rowMin;r <= rowMax;r++) {
+		for(int c = colMin;c <= colMax;c++) {
+			// Distance from the cell center to the closest point of the segment.
+			double t = length2 > 0 ? ((r - r0) * dr + (c - c0) * dc) / length2 : 0;
+			t = std::min(1.0, std::max(0.0, t));
+			double er = r - (r0 + t * dr);
+			double ec = c - (c0 + t * dc);
+			if(er*er + ec*ec <= radius * radius) {
+				mask[r * cols + c] = 1;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Covers the cells of an arbitrary shape. See Shape::cells().
+ */
+void Geometry::shape(const Shape& shape, double row, double col, double angle) {
+	for(int i : shape.cells(rows, cols, col, row, angle)) {
+		mask[i] = 1;
+	}
+}
+
+/**
+ * @brief Covers the cells whose pixel is set in a black-and-white image, stretched to the grid.
+ * @param pixels	row-major pixels, true for solid
+ * @param height	image height in pixels
+ * @param width		image width in pixels
+ */
+void Geometry::image(const std::vector<bool>& pixels, int height, int width) {
+	for(int r = 0;r < rows;r++) {
+		int y = (int)((r + 0.5) * height / rows);
+		for(int c = 0;c < cols;c++) {
+			int x = (int)((c + 0.5) * width / cols);
+			if(pixels[y * width + x]) {
+				mask[r * cols + c] = 1;
+			}
+		}
+	}
+}
+
+/**
+ * @brief Geometry::cells
+ * @return row-major indices of every covered cell, sorted
+ */
+std::vector<int> Geometry::cells() const {
+	std::vector<int> cells;
+	for(int i = 0;i < rows * cols;i++) {
+		if(mask[i]) {
+			cells.push_back(i);
+		}
+	}
+	return cells;
+}
@@ -0,0 +1,34 @@
+#ifndef GEOMETRY_HPP
+#define GEOMETRY_HPP
+
+#include "Shape.hpp"
+
+#include <utility>
+#include <vector>
+
+/**
+ * Collects barrier shapes for a grid so they can be applied to a SimState in one pass.
+ *
+ * Shapes are rasterized into a scratch mask; cells() then lists the covered cells in the sorted
+ * row-major order SimState::setBarriers() expects. Coordinates are (row, col) in cells.
+ */
+class Geometry {
+	int rows;
+	int cols;
+	std::vector<char> mask;
+
+	void capsule(double r0, double c0, double r1, double c1, double radius);
+
+public:
+	Geometry(int rows, int cols);
+
+	void rectangle(int row, int col, int height, int width);
+	void circle(double row, double col, double radius);
+	void polyline(const std::vector<std::pair<double, double>>& points, double thickness);
+	void shape(const Shape& shape, double row, double col, double angle = 0);
+	void image(const std::vector<bool>& pixels, int height, int width);
+
+	std::vector<int> cells() const;
+};
+
+#endif // GEOMETRY_HPP
@@ -0,0 +1,887 @@
+#include "Headless.hpp"
+#include "Checkpointer.hpp"
+#include "FrameServer.hpp"
+#include "Geometry.hpp"
+#include "MomentLattice.hpp"
+#include "MultiBlock.hpp"
+#include "Profiler.hpp"
+#include "ShiftedLattice.hpp"
+#include "SimState.hpp"
+#include "Sweep.hpp"
+#include "Tracer.hpp"
+#include "Tuner.hpp"
+
+#include <boost/optional.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+static void usage() {
+	std::cerr << "usage: vizualizer --headless <initial.istate> [options]\n"
+			  << "  --steps N           maximum number of steps (default 10000)\n"
+			  << "  --converge-every K  sample the residual every K steps and stop at steady state\n"
+			  << "  --tolerance T       residual below which the run is steady (default 1e-6)\n"
+			  << "  --norm l2|linf      norm of the velocity change (default linf)\n"
+			  << "  --collision bgk|trt|mrt|reg  collision operator (default: the one saved in the file)\n"
+			  << "  --inlet forced|velocity|pressure  boundary on the first column (default: from the file)\n"
+			  << "  --inlet-density D   density held by a pressure inlet (default 1)\n"
+			  << "  --outlet periodic|zero-gradient|convective  boundary on the last column\n"
+			  << "  --output FILE       save the final state to FILE\n"
+			  << "  --residuals FILE    write the convergence history to FILE as CSV\n"
+			  << "  --timings FILE      write per-phase timings to FILE (.csv or .json)\n"
+			  << "  --trace FILE        record a Chrome trace-event timeline to FILE\n"
+			  << "  --checkpoint-every N  write a checkpoint every N steps (resume by passing it as input)\n"
+			  << "  --checkpoint-dir DIR  directory for checkpoints (default .)\n"
+			  << "  --stirrer R,C,L,W   add a plate of length L spinning at W radians/step about (R, C)\n"
+			  << "  --serve PORT        stream frames to viewers on localhost:PORT (see tools/frame_client.cpp)\n"
+			  << "  --serve-downsample F  average FxF cells into one before streaming (default 1)\n"
+			  << "  --ring NAME         publish the fields to POSIX shared memory NAME (see tools/ring_reader.cpp)\n"
+			  << "  --ring-every N      steps between publications to the ring (default 1)\n"
+			  << "  --refine F          run coarse (F times the cell size) away from barriers, F = 2 or 4\n"
+			  << "  --refine-block B    coarse cells per block side with --refine (default 8)\n"
+			  << "  --moments           store 6 moments per cell instead of 9 populations (implies --collision reg)\n"
+			  << "  --precision double|single|half|auto  store populations as f - w in this precision (bgk only);\n"
+			  << "                      auto takes the faster of double and single on this host\n"
+			  << "  --threads N         threads stepping tiles with --precision (default: tuned, 0 = one per core)\n"
+			  << "  --tile RxC          tile size with --precision (default: tuned)\n"
+			  << "  --variant P,RxC,N   use precision P, RxC tiles and N threads instead of tuning, e.g. single,64x64,4\n"
+			  << "  --tuning-cache FILE  where tuned variants are kept (default ~/.cache/vizualizer-tuning)\n"
+			  << "  --pin               pin each --threads worker to its own CPU\n"
+			  << "  --huge-pages        back the lattice of a --precision run with transparent huge pages\n";
+}
+
+/**
+ * @brief Loads a state from an .istate file.
+ * @return false if the file could not be opened
+ */
+static bool loadState(const std::string& path, boost::optional<SimState>& state) {
+	std::ifstream file(path, std::ios::binary);
+	if(!file) {
+		std::cerr << "cannot open " << path << "\n";
+		return false;
+	}
+	DataStream in(file);
+	state = SimState::load(in);
+	if(!in.ok()) {
+		std::cerr << path << " is truncated or damaged\n";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Parses a whole argument as an int, e.g. for --steps.
+ * @return false if it is not a number, has trailing characters or is out of range
+ */
+template<typename T>
+static bool parseInt(const std::string& text, T& value) {
+	char* end;
+	errno = 0;
+	long parsed = std::strtol(text.c_str(), &end, 10);
+	if(end == text.c_str() || *end != '\0' || errno == ERANGE || parsed < INT_MIN || parsed > INT_MAX) {
+		return false;
+	}
+	value = (int)parsed;
+	return true;
+}
+
+/**
+ * @brief Parses a whole argument as a double, e.g. for --tolerance.
+ * @return false if it is not a number or has trailing characters
+ */
+template<typename T>
+static bool parseDouble(const std::string& text, T& value) {
+	char* end;
+	errno = 0;
+	double parsed = std::strtod(text.c_str(), &end);
+	if(end == text.c_str() || *end != '\0' || errno == ERANGE) {
+		return false;
+	}
+	value = parsed;
+	return true;
+}
+
+/**
+ * @brief Parses a collision model name as accepted by --collision.
+ * @return false if the name is unknown
+ */
+static bool parseCollision(const std::string& name, boost::optional<SimState::CollisionModel>& model) {
+	if(name == "bgk") {
+		model = SimState::BGK;
+	} else if(name == "trt") {
+		model = SimState::TRT;
+	} else if(name == "mrt") {
+		model = SimState::MRT;
+	} else if(name == "reg") {
+		model = SimState::REGULARIZED;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Parses an inlet name as accepted by --inlet.
+ * @return false if the name is unknown
+ */
+static bool parseInlet(const std::string& name, boost::optional<SimState::Inlet>& inlet) {
+	if(name == "forced") {
+		inlet = SimState::FORCED_EQUILIBRIUM;
+	} else if(name == "velocity") {
+		inlet = SimState::VELOCITY;
+	} else if(name == "pressure") {
+		inlet = SimState::PRESSURE;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Parses an outlet name as accepted by --outlet.
+ * @return false if the name is unknown
+ */
+static bool parseOutlet(const std::string& name, boost::optional<SimState::Outlet>& outlet) {
+	if(name == "periodic") {
+		outlet = SimState::PERIODIC;
+	} else if(name == "zero-gradient") {
+		outlet = SimState::ZERO_GRADIENT;
+	} else if(name == "convective") {
+		outlet = SimState::CONVECTIVE;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Parses a storage precision as accepted by --precision.
+ * @return false if the name is unknown
+ */
+static bool parsePrecision(const std::string& name, boost::optional<ShiftedLattice::Precision>& precision) {
+	if(name == "double") {
+		precision = ShiftedLattice::DOUBLE;
+	} else if(name == "single") {
+		precision = ShiftedLattice::SINGLE;
+	} else if(name == "half") {
+		precision = ShiftedLattice::HALF;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief The variant stored for this host and grid, or else the fastest one after timing them
+ * all, which is then stored.
+ *
+ * @param allowed	precisions to choose from
+ * @param cacheFile	the tuning cache, empty to always tune
+ * @return the variant, none if no precision was allowed
+ */
+static boost::optional<Tuner::Variant> tunedVariant(SimState& state, const std::vector<ShiftedLattice::Precision>& allowed,
+								   const std::string& cacheFile) {
+	int height = state.ux().n_rows;
+	int width = state.ux().n_cols;
+
+	Tuner tuner(cacheFile);
+	auto cached = tuner.cached(height, width, allowed);
+	if(cached) {
+		std::cout << "using tuned variant " << Tuner::format(*cached) << " from " << cacheFile << "\n";
+		return *cached;
+	}
+
+	std::cout << "tuning for " << height << "x" << width << " on " << Tuner::cpuModel() << "\n";
+	auto best = tuner.tune(state, allowed);
+	if(!best) {
+		return boost::none;
+	}
+	std::cout << "tuned variant " << Tuner::format(*best) << ", " << best->mlups << " MLUPS\n";
+	if(!cacheFile.empty() && !tuner.store(height, width, allowed, *best)) {
+		std::cerr << "cannot write " << cacheFile << "\n";
+	}
+
+	// Keep the timing runs out of the step statistics of the real one.
+	Profiler::instance().clear();
+	return best;
+}
+
+/**
+ * @brief Parses either a comma separated list ("0.01,0.02") or a range "start:stop:count".
+ * @return false if any of the numbers is malformed
+ */
+static bool parseValues(const std::string& text, std::vector<double>& values) {
+	values.clear();
+
+	if(std::count(text.begin(), text.end(), ':') == 2) {
+		auto a = text.find(':');
+		auto b = text.find(':', a + 1);
+		double start;
+		double stop;
+		int count;
+		if(!parseDouble(text.substr(0, a), start) || !parseDouble(text.substr(a + 1, b - a - 1), stop)
+				|| !parseInt(text.substr(b + 1), count)) {
+			return false;
+		}
+		for(int i = 0;i < count;i++) {
+			values.push_back(count == 1 ? start : start + (stop - start) * i / (count - 1));
+		}
+		return true;
+	}
+
+	std::stringstream stream(text);
+	std::string item;
+	while(std::getline(stream, item, ',')) {
+		double value;
+		if(!parseDouble(item, value)) {
+			return false;
+		}
+		values.push_back(value);
+	}
+	return true;
+}
+
+int runHeadless(int argc, char* argv[]) {
+	std::string input;
+	std::string output;
+	std::string residualsFile;
+	std::string timingsFile;
+	std::string traceFile;
+	std::string checkpointDir = ".";
+	int checkpointInterval = 0;
+	int servePort = -1;
+	int serveFactor = 1;
+	std::string ringName;
+	int ringInterval = 1;
+	std::vector<Obstacle> obstacles;
+	int maxSteps = 10000;
+	int interval = 0;
+	double tolerance = 1e-6;
+	SimState::ResidualNorm norm = SimState::LINF;
+	boost::optional<SimState::CollisionModel> collision;
+	int refine = 0;
+	int refineBlock = 8;
+	bool moments = false;
+	boost::optional<ShiftedLattice::Precision> precision;
+	bool autoPrecision = false;
+	boost::optional<int> threads;
+	boost::optional<int> tileRows;
+	boost::optional<int> tileCols;
+	boost::optional<Tuner::Variant> variant;
+	boost::optional<std::string> tuningCache;
+	bool pin = false;
+	bool hugePages = false;
+	boost::optional<SimState::Inlet> inlet;
+	boost::optional<SimState::Outlet> outlet;
+	boost::optional<double> inletDensity;
+
+	for(int i = 2;i < argc;i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if(arg == "--steps" && hasValue) {
+			if(!parseInt(argv[++i], maxSteps)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--converge-every" && hasValue) {
+			if(!parseInt(argv[++i], interval)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--tolerance" && hasValue) {
+			if(!parseDouble(argv[++i], tolerance)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--norm" && hasValue) {
+			std::string value = argv[++i];
+			if(value == "l2") {
+				norm = SimState::L2;
+			} else if(value == "linf") {
+				norm = SimState::LINF;
+			} else {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--collision" && hasValue) {
+			if(!parseCollision(argv[++i], collision)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--inlet" && hasValue) {
+			if(!parseInlet(argv[++i], inlet)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--inlet-density" && hasValue) {
+			if(!parseDouble(argv[++i], inletDensity)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--outlet" && hasValue) {
+			if(!parseOutlet(argv[++i], outlet)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--output" && hasValue) {
+			output = argv[++i];
+		} else if(arg == "--residuals" && hasValue) {
+			residualsFile = argv[++i];
+		} else if(arg == "--timings" && hasValue) {
+			timingsFile = argv[++i];
+		} else if(arg == "--trace" && hasValue) {
+			traceFile = argv[++i];
+		} else if(arg == "--checkpoint-every" && hasValue) {
+			if(!parseInt(argv[++i], checkpointInterval)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--checkpoint-dir" && hasValue) {
+			checkpointDir = argv[++i];
+		} else if(arg == "--serve" && hasValue) {
+			if(!parseInt(argv[++i], servePort)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--serve-downsample" && hasValue) {
+			if(!parseInt(argv[++i], serveFactor)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--ring" && hasValue) {
+			ringName = argv[++i];
+		} else if(arg == "--ring-every" && hasValue) {
+			if(!parseInt(argv[++i], ringInterval)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--refine" && hasValue) {
+			if(!parseInt(argv[++i], refine)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--refine-block" && hasValue) {
+			if(!parseInt(argv[++i], refineBlock)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--moments") {
+			moments = true;
+		} else if(arg == "--precision" && hasValue) {
+			std::string value = argv[++i];
+			if(value == "auto") {
+				autoPrecision = true;
+			} else if(!parsePrecision(value, precision)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--threads" && hasValue) {
+			if(!parseInt(argv[++i], threads)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--tile" && hasValue) {
+			std::string value = argv[++i];
+			auto x = value.find('x');
+			if(x == std::string::npos) {
+				usage();
+				return 1;
+			}
+			if(!parseInt(value.substr(0, x), tileRows) || !parseInt(value.substr(x + 1), tileCols)) {
+				usage();
+				return 1;
+			}
+		} else if(arg == "--variant" && hasValue) {
+			Tuner::Variant forced;
+			if(!Tuner::parse(argv[++i], forced)) {
+				usage();
+				return 1;
+			}
+			variant = forced;
+		} else if(arg == "--tuning-cache" && hasValue) {
+			tuningCache = std::string(argv[++i]);
+		} else if(arg == "--pin") {
+			pin = true;
+		} else if(arg == "--huge-pages") {
+			hugePages = true;
+		} else if(arg == "--stirrer" && hasValue) {
+			std::vector<double> v;
+			if(!parseValues(argv[++i], v) || v.size() != 4) {
+				usage();
+				return 1;
+			}
+			Obstacle stirrer(Shape::rectangle(v[2], 2), v[1], v[0]);
+			stirrer.angularVelocity = v[3];
+			obstacles.push_back(stirrer);
+		} else if(input.empty() && arg[0] != '-') {
+			input = arg;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	if(input.empty()) {
+		usage();
+		return 1;
+	}
+
+	if(!timingsFile.empty()) {
+		// One sample per step and phase of the whole run, not just the most recent ones.
+		Profiler::instance().setHistory(std::max<size_t>(Profiler::HISTORY, maxSteps));
+	}
+
+	if(!traceFile.empty()) {
+		Tracer::instance().setThreadName("main");
+		Tracer::instance().setEnabled(true);
+	}
+
+	boost::optional<SimState> loaded;
+	if(!loadState(input, loaded)) {
+		return 1;
+	}
+	SimState& state = *loaded;
+	for(auto& o : obstacles) {
+		state.addObstacle(o);
+	}
+	if(collision) {
+		state.setCollisionModel(*collision);
+	}
+	if(inlet || outlet || inletDensity) {
+		state.setBoundaries(inlet ? *inlet : state.inlet(), outlet ? *outlet : state.outlet(),
+							inletDensity ? *inletDensity : state.inletDensity());
+	}
+
+	// Only the latest frame is ever looked at: the final one, or one for a viewer. A run that
+	// stops early at steady state computed its fields for the residual sample.
+	state.setFrameLimit(1);
+	state.setCapturePolicy(SimState::EVERY_N, maxSteps);
+	if(interval > 0) {
+		state.setConvergence(interval, tolerance, norm);
+	}
+
+	if(state.steps() > 0) {
+		std::cout << "resuming at step " << state.steps() << "\n";
+	}
+
+	boost::optional<MultiBlock> refined;
+	if(refine > 0) {
+		if(interval > 0 || checkpointInterval > 0 || !ringName.empty() || !state.obstacles().empty()
+				|| state.collisionModel() != SimState::BGK
+				|| state.inlet() != SimState::FORCED_EQUILIBRIUM || state.outlet() != SimState::PERIODIC) {
+			std::cerr << "--refine cannot be combined with convergence checks, checkpoints, the ring, "
+					  << "moving obstacles, collision models other than bgk or open boundaries\n";
+			return 1;
+		}
+		if(!MultiBlock::fits(state.ux().n_rows, state.ux().n_cols, refine, refineBlock)) {
+			std::cerr << "--refine " << refine << " needs height and width to be multiples of "
+					  << refine * refineBlock << "\n";
+			return 1;
+		}
+		refined.emplace(state, refine, refineBlock);
+		std::cout << refined->refinedBlocks() << " refined blocks, "
+				  << state.ux().n_elem / refined->cellsPerStep() << "x fewer cell updates\n";
+	}
+
+	boost::optional<MomentLattice> momentLattice;
+	if(moments) {
+		if(refined || interval > 0 || checkpointInterval > 0 || !ringName.empty()
+				|| !state.obstacles().empty() || (collision && *collision != SimState::REGULARIZED)
+				|| state.inlet() != SimState::FORCED_EQUILIBRIUM || state.outlet() != SimState::PERIODIC) {
+			std::cerr << "--moments cannot be combined with --refine, convergence checks, checkpoints, "
+					  << "the ring, moving obstacles, collision models other than reg or open boundaries\n";
+			return 1;
+		}
+		momentLattice.emplace(state);
+	}
+
+	boost::optional<ShiftedLattice> shifted;
+	if(precision || autoPrecision || variant) {
+		if(refined || momentLattice || interval > 0 || checkpointInterval > 0 || !ringName.empty()
+				|| !state.obstacles().empty() || state.collisionModel() != SimState::BGK
+				|| state.inlet() != SimState::FORCED_EQUILIBRIUM || state.outlet() != SimState::PERIODIC) {
+			std::cerr << "--precision cannot be combined with --refine, --moments, convergence checks, "
+					  << "checkpoints, the ring, moving obstacles, collision models other than bgk or "
+					  << "open boundaries\n";
+			return 1;
+		}
+
+		// A forced variant is used as is. Otherwise tile size and threads are tuned unless both
+		// are given, and --precision auto always is; given settings override tuned ones.
+		Tuner::Variant chosen = {precision ? *precision : ShiftedLattice::DOUBLE, 64, 64, 1, 0};
+		if(variant) {
+			chosen = *variant;
+		} else {
+			if(autoPrecision || !tileRows || !threads) {
+				std::vector<ShiftedLattice::Precision> allowed;
+				if(autoPrecision) {
+					allowed = {ShiftedLattice::DOUBLE, ShiftedLattice::SINGLE};
+				} else {
+					allowed = {*precision};
+				}
+				auto tuned = tunedVariant(state, allowed, tuningCache ? *tuningCache : Tuner::defaultCacheFile());
+				if(!tuned) {
+					std::cerr << "no precision to tune for\n";
+					return 1;
+				}
+				chosen = *tuned;
+			}
+			if(tileRows) {
+				chosen.tileRows = *tileRows;
+				chosen.tileCols = *tileCols;
+			}
+			if(threads) {
+				chosen.threads = *threads;
+			}
+		}
+
+		shifted.emplace(state, chosen.precision);
+		shifted->setTileSize(chosen.tileRows, chosen.tileCols);
+		if(hugePages) {
+			shifted->setHugePages(true);
+		}
+		shifted->setThreads(chosen.threads, pin);
+	}
+
+	Checkpointer checkpointer(checkpointDir, checkpointInterval);
+	checkpointer.update(state);
+
+	FrameServer server(serveFactor);
+	if(servePort >= 0) {
+		if(!server.start(servePort)) {
+			std::cerr << "cannot listen on port " << servePort << "\n";
+			return 1;
+		}
+		std::cout << "serving frames on 127.0.0.1:" << server.port() << "\n";
+	}
+
+	if(!ringName.empty()) {
+		auto ring = std::make_shared<FrameRing>();
+		if(!ring->create(ringName, state.ux().n_rows, state.ux().n_cols)) {
+			std::cerr << "cannot create shared memory " << ringName << "\n";
+			return 1;
+		}
+		state.setFrameRing(ring, ringInterval);
+	}
+
+	while(refined && refined->steps() < maxSteps) {
+		refined->step();
+		if(server.wants()) {
+			server.publish(refined->steps(), refined->getFrame());
+		}
+	}
+	if(refined) {
+		state = refined->state();
+	}
+
+	while(momentLattice && momentLattice->steps() < maxSteps) {
+		momentLattice->step();
+		if(server.wants()) {
+			server.publish(momentLattice->steps(), momentLattice->getFrame());
+		}
+	}
+	if(momentLattice) {
+		state = momentLattice->state();
+	}
+
+	while(shifted && shifted->steps() < maxSteps) {
+		shifted->step();
+		if(server.wants()) {
+			server.publish(shifted->steps(), shifted->getFrame());
+		}
+	}
+	if(shifted) {
+		state = shifted->state();
+	}
+
+	while(state.steps() < maxSteps && !state.converged()) {
+		state.step();
+		checkpointer.update(state);
+		if(server.wants()) {
+			state.captureFrame();
+			server.publish(state.steps(), state.getFrame(-1));
+		}
+	}
+	checkpointer.flush();
+	server.stop();
+
+	if(state.converged()) {
+		std::cout << "converged after " << state.steps() << " steps, residual "
+				  << state.residuals().back().value << "\n";
+	} else {
+		std::cout << "stopped after " << state.steps() << " steps without converging\n";
+	}
+
+	if(!residualsFile.empty()) {
+		std::ofstream csv(residualsFile);
+		csv << "step,residual\n";
+		for(auto& r : state.residuals()) {
+			csv << r.step << "," << r.value << "\n";
+		}
+	}
+
+	auto stats = Profiler::instance().stats("step");
+	std::cout << "step " << stats.mean << " ms mean, " << stats.p99 << " ms p99, "
+			  << stats.mlups << " MLUPS\n";
+
+	if(!timingsFile.empty()) {
+		bool json = timingsFile.size() >= 5 && timingsFile.substr(timingsFile.size() - 5) == ".json";
+		bool ok = json ? Profiler::instance().writeJson(timingsFile)
+					   : Profiler::instance().writeCsv(timingsFile);
+		if(!ok) {
+			std::cerr << "cannot write " << timingsFile << "\n";
+		}
+	}
+
+	if(!traceFile.empty() && !Tracer::instance().write(traceFile)) {
+		std::cerr << "cannot write " << traceFile << "\n";
+	}
+
+	if(!output.empty()) {
+		std::ofstream out(output, std::ios::binary);
+		DataStream stream(out);
+		state.save(stream);
+		out.close();
+		if(!stream.ok() || !out) {
+			std::cerr << "cannot write " << output << "\n";
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static void sweepUsage() {
+	std::cerr << "usage: vizualizer --sweep <geometry.istate> --viscosity LIST --u0 LIST [options]\n"
+			  << "  LIST is either a,b,c or start:stop:count\n"
+			  << "  --steps N           maximum number of steps per case (default 10000)\n"
+			  << "  --converge-every K  stop each case at steady state, sampling every K steps\n"
+			  << "  --tolerance T       residual below which a case is steady (default 1e-6)\n"
+			  << "  --threads N         worker threads (default: one per core)\n"
+			  << "  --lanes N           cases stepped together per task (default: 8 up to 200x200)\n"
+			  << "  --collision bgk|trt|mrt|reg  collision operator (default: the one saved in the file;\n"
+			  << "                      anything but bgk runs one case per task)\n"
+			  << "  --output-dir DIR    write case_<i>.istate and sweep.csv to DIR\n";
+}
+
+int runSweep(int argc, char* argv[]) {
+	std::string input;
+	std::string outputDir;
+	std::vector<double> viscosities;
+	std::vector<double> u0s;
+	int maxSteps = 10000;
+	int interval = 0;
+	double tolerance = 1e-6;
+	int threads = 0;
+	int lanes = 0;
+	boost::optional<SimState::CollisionModel> collision;
+
+	for(int i = 2;i < argc;i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if(arg == "--viscosity" && hasValue) {
+			if(!parseValues(argv[++i], viscosities)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--u0" && hasValue) {
+			if(!parseValues(argv[++i], u0s)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--steps" && hasValue) {
+			if(!parseInt(argv[++i], maxSteps)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--converge-every" && hasValue) {
+			if(!parseInt(argv[++i], interval)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--tolerance" && hasValue) {
+			if(!parseDouble(argv[++i], tolerance)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--threads" && hasValue) {
+			if(!parseInt(argv[++i], threads)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--lanes" && hasValue) {
+			if(!parseInt(argv[++i], lanes)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--collision" && hasValue) {
+			if(!parseCollision(argv[++i], collision)) {
+				sweepUsage();
+				return 1;
+			}
+		} else if(arg == "--output-dir" && hasValue) {
+			outputDir = argv[++i];
+		} else if(input.empty() && arg[0] != '-') {
+			input = arg;
+		} else {
+			sweepUsage();
+			return 1;
+		}
+	}
+
+	if(input.empty() || viscosities.empty() || u0s.empty()) {
+		sweepUsage();
+		return 1;
+	}
+
+	boost::optional<SimState> geometry;
+	if(!loadState(input, geometry)) {
+		return 1;
+	}
+	if(collision) {
+		geometry->setCollisionModel(*collision);
+	}
+
+	Sweep sweep(*geometry);
+	sweep.setSteps(maxSteps);
+	sweep.setThreads(threads);
+	sweep.setLanes(lanes);
+	sweep.setOutputDir(outputDir);
+	if(interval > 0) {
+		sweep.setConvergence(interval, tolerance);
+	}
+
+	auto results = sweep.run(Sweep::grid(viscosities, u0s));
+
+	for(auto& r : results) {
+		std::cout << "viscosity " << r.params.viscosity << ", u0 " << r.params.u0 << ": " << r.steps
+				  << " steps" << (r.converged ? " (converged)" : "") << ", " << r.seconds << " s\n";
+	}
+	double casesPerSecond = sweep.seconds() > 0 ? results.size() / sweep.seconds() : 0;
+	std::cout << results.size() << " cases in " << sweep.seconds() << " s, "
+			  << casesPerSecond << " cases/s, " << sweep.mlups() << " MLUPS\n";
+
+	return 0;
+}
+
+static void validateUsage() {
+	std::cerr << "usage: vizualizer --validate [geometry.istate] [options]\n"
+			  << "  without a file, runs a cylinder at Re 100 in a 100x400 channel\n"
+			  << "  --precision single|half  storage precision to check (default half)\n"
+			  << "  --steps N           steps to run (default 5000)\n"
+			  << "  --every K           steps between reports (default 500)\n"
+			  << "  --tolerance T       largest accepted velocity error, relative L2 (default 1e-2)\n";
+}
+
+int runValidate(int argc, char* argv[]) {
+	std::string input;
+	boost::optional<ShiftedLattice::Precision> precision;
+	int maxSteps = 5000;
+	int every = 500;
+	double tolerance = 1e-2;
+
+	for(int i = 2;i < argc;i++) {
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if(arg == "--precision" && hasValue) {
+			if(!parsePrecision(argv[++i], precision)) {
+				validateUsage();
+				return 1;
+			}
+		} else if(arg == "--steps" && hasValue) {
+			if(!parseInt(argv[++i], maxSteps)) {
+				validateUsage();
+				return 1;
+			}
+		} else if(arg == "--every" && hasValue) {
+			if(!parseInt(argv[++i], every)) {
+				validateUsage();
+				return 1;
+			}
+		} else if(arg == "--tolerance" && hasValue) {
+			if(!parseDouble(argv[++i], tolerance)) {
+				validateUsage();
+				return 1;
+			}
+		} else if(input.empty() && arg[0] != '-') {
+			input = arg;
+		} else {
+			validateUsage();
+			return 1;
+		}
+	}
+	if(every <= 0) {
+		validateUsage();
+		return 1;
+	}
+
+	boost::optional<SimState> loaded;
+	if(input.empty()) {
+		// Slightly off the centre line so the wake starts shedding.
+		loaded.emplace(100, 400, 0.02, 0.1);
+		Geometry geometry(100, 400);
+		geometry.circle(50.3, 80, 10);
+		loaded->setBarriers(geometry.cells(), true);
+	} else if(!loadState(input, loaded)) {
+		return 1;
+	}
+	SimState& reference = *loaded;
+	if(!reference.obstacles().empty() || reference.collisionModel() != SimState::BGK
+			|| reference.inlet() != SimState::FORCED_EQUILIBRIUM || reference.outlet() != SimState::PERIODIC) {
+		std::cerr << "--validate needs a state with bgk collision, no moving obstacles and periodic "
+				  << "boundaries\n";
+		return 1;
+	}
+	reference.setFrameLimit(1);
+
+	ShiftedLattice shifted(reference, precision ? *precision : ShiftedLattice::HALF);
+	const arma::uword rows = reference.ux().n_rows;
+	const arma::uword cols = reference.ux().n_cols;
+	double speed = 0;
+	double worst = 0;
+
+	for(int step = 1;step <= maxSteps;step++) {
+		reference.step();
+		shifted.step();
+		if(step % every != 0 && step != maxSteps) {
+			continue;
+		}
+
+		double error = 0;
+		double norm = 0;
+		double largest = 0;
+		for(arma::uword col = 0;col < cols;col++) {
+			for(arma::uword row = 0;row < rows;row++) {
+				if(reference.isSolid(row, col)) {
+					continue;
+				}
+				double ux = reference.ux()(row, col);
+				double uy = reference.uy()(row, col);
+				double dx = shifted.ux()(row, col) - ux;
+				double dy = shifted.uy()(row, col) - uy;
+				error += dx*dx + dy*dy;
+				norm += ux*ux + uy*uy;
+				largest = std::max(largest, std::sqrt(dx*dx + dy*dy));
+				speed = std::max(speed, std::sqrt(ux*ux + uy*uy));
+			}
+		}
+		double relative = norm > 0 ? std::sqrt(error / norm) : 0;
+		worst = std::max(worst, relative);
+		std::cout << "step " << step << ": relative L2 error " << relative << ", largest "
+				  << largest << " (peak speed " << speed << ")\n";
+	}
+
+	std::cout << shifted.bytesPerCell() << " bytes per cell; worst relative error " << worst
+			  << (worst <= tolerance ? " within " : " above ") << tolerance << "\n";
+	return worst <= tolerance ? 0 : 1;
+}
@@ -0,0 +1,32 @@
+#ifndef HEADLESS_HPP
+#define HEADLESS_HPP
+
+/**
+ * Runs a simulation without a window, for batch jobs.
+ *
+ * Usage: vizualizer --headless <initial.istate> [options]
+ *
+ * @return the process exit code
+ */
+int runHeadless(int argc, char* argv[]);
+
+/**
+ * Runs one geometry over a grid of viscosities and in-flow speeds on all cores.
+ *
+ * Usage: vizualizer --sweep <geometry.istate> --viscosity LIST --u0 LIST [options]
+ *
+ * @return the process exit code
+ */
+int runSweep(int argc, char* argv[]);
+
+/**
+ * Runs a state in double precision and with ShiftedLattice side by side and reports how far the
+ * reduced-precision velocity drifts.
+ *
+ * Usage: vizualizer --validate [geometry.istate] [--precision single|half] [options]
+ *
+ * @return the process exit code, 1 if the error exceeds the tolerance
+ */
+int runValidate(int argc, char* argv[]);
+
+#endif // HEADLESS_HPP
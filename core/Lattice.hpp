@@ -0,0 +1,22 @@
+#ifndef LATTICE_HPP
+#define LATTICE_HPP
+
+/**
+ * D2Q9 lattice constants shared by the kernels.
+ *
+ * Row + is north and column + is east, as in SimState::stream(). A population moving in
+ * direction d goes from (row, col) to (row + dRow[d], col + dCol[d]) in one step.
+ */
+namespace lattice {
+
+enum Direction {D0, DN, DS, DE, DW, DNE, DSE, DNW, DSW};
+
+constexpr int dRow[9] = {0, 1, -1, 0, 0, 1, -1, 1, -1};
+constexpr int dCol[9] = {0, 0, 0, 1, -1, 1, 1, -1, -1};
+constexpr int opposite[9] = {D0, DS, DN, DW, DE, DSW, DNW, DSE, DNE};
+constexpr double weight[9] = {4.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/9.0, 1.0/9.0,
+							  1.0/36.0, 1.0/36.0, 1.0/36.0, 1.0/36.0};
+
+}
+
+#endif // LATTICE_HPP
@@ -0,0 +1,295 @@
+#include "MomentLattice.hpp"
+#include "Lattice.hpp"
+#include "Profiler.hpp"
+
+#include <cmath>
+#include <cstring>
+
+using namespace lattice;
+
+static constexpr double one9th   = 1.0/9.0;
+static constexpr double one36th  = 1.0/36.0;
+
+enum Moment {RHO, UX, UY, PXX, PXY, PYY};
+
+enum Kind : char {FLUID, NEAR_BARRIER, BARRIER};
+
+/**
+ * @brief Post-collision population in direction d of a cell, rebuilt from its moments.
+ *
+ * @param m		the six moments of a column, m[k][row]
+ * @param row	row of the cell
+ * @param d		direction
+ * @param keep	1 - omega, the share of the non-equilibrium stress that survives collision
+ */
+static inline double rebuild(const double* const* m, int row, int d, double keep) {
+	double density = m[RHO][row];
+	double ux = m[UX][row];
+	double uy = m[UY][row];
+	double pxx = m[PXX][row];
+	double pxy = m[PXY][row];
+	double pyy = m[PYY][row];
+
+	double cu = dCol[d]*ux + dRow[d]*uy;
+	double eq = weight[d] * density * (1 - 1.5*(ux*ux + uy*uy) + 3*cu + 4.5*cu*cu);
+
+	// w_d * 4.5 * (c_d c_d - I/3) : Pi, as in SimState::collideRegularized()
+	double q = dCol[d]*dCol[d]*pxx + 2*dCol[d]*dRow[d]*pxy + dRow[d]*dRow[d]*pyy - (pxx + pyy) / 3;
+	return eq + keep * weight[d] * 4.5 * q;
+}
+
+/**
+ * @brief Builds the lattice from a state, e.g. one just loaded.
+ *
+ * Density and velocity come from the populations; the stress is the non-equilibrium stress of
+ * the populations divided by 1 - omega, so the first step streams what the state would have.
+ * The barrier array is shared with the geometry state and must not be edited afterwards.
+ *
+ * @param geometry	state with the barriers, flow parameters and initial populations
+ */
+MomentLattice::MomentLattice(const SimState& geometry) :
+	height(geometry.height),
+	width(geometry.width),
+	omega(geometry.omega),
+	u0(geometry.u0),
+	barrier(geometry.barrier),
+	kind((size_t)geometry.height * geometry.width, FLUID),
+	rho(geometry.height, geometry.width),
+	_ux(geometry.height, geometry.width),
+	_uy(geometry.height, geometry.width),
+	_pxx(geometry.height, geometry.width),
+	_pxy(geometry.height, geometry.width),
+	_pyy(geometry.height, geometry.width),
+	first(6 * geometry.height),
+	previous(6 * geometry.height),
+	current(6 * geometry.height),
+	_steps(geometry._steps)
+{
+	const arma::mat* n[9];
+	geometry.populations(n);
+	double keep = 1 - omega;
+	double unkeep = std::abs(keep) > 1e-12 ? 1 / keep : 0;
+
+	for(int col = 0;col < width;col++) {
+		for(int row = 0;row < height;row++) {
+			if(barrier[row * width + col]) {
+				kind[(size_t)col * height + row] = BARRIER;
+			} else {
+				for(int d = 1;d < 9;d++) {
+					int r = (row + dRow[d] + height) % height;
+					int c = (col + dCol[d] + width) % width;
+					if(barrier[r * width + c]) {
+						kind[(size_t)col * height + row] = NEAR_BARRIER;
+					}
+				}
+			}
+
+			double p[9];
+			for(int d = 0;d < 9;d++) {
+				p[d] = (*n[d])(row, col);
+			}
+			double density = p[D0] + p[DN] + p[DS] + p[DE] + p[DW] + p[DNE] + p[DSE] + p[DNW] + p[DSW];
+			double ux = (p[DE] + p[DNE] + p[DSE] - p[DW] - p[DNW] - p[DSW]) / density;
+			double uy = (p[DN] + p[DNE] + p[DNW] - p[DS] - p[DSE] - p[DSW]) / density;
+
+			double pxx = 0;
+			double pxy = 0;
+			double pyy = 0;
+			for(int d = 0;d < 9;d++) {
+				double cu = dCol[d]*ux + dRow[d]*uy;
+				double neq = p[d] - weight[d] * density * (1 - 1.5*(ux*ux + uy*uy) + 3*cu + 4.5*cu*cu);
+				pxx += dCol[d]*dCol[d] * neq;
+				pxy += dCol[d]*dRow[d] * neq;
+				pyy += dRow[d]*dRow[d] * neq;
+			}
+
+			rho(row, col) = density;
+			_ux(row, col) = ux;
+			_uy(row, col) = uy;
+			_pxx(row, col) = pxx * unkeep;
+			_pxy(row, col) = pxy * unkeep;
+			_pyy(row, col) = pyy * unkeep;
+		}
+	}
+}
+
+/**
+ * @brief Streams and collides every cell in one pass.
+ */
+void MomentLattice::step() {
+	PROFILE_SCOPE_CELLS("step", (long)height * width);
+
+	const double keep = 1 - omega;
+	arma::mat* fields[6] = {&rho, &_ux, &_uy, &_pxx, &_pxy, &_pyy};
+
+	// What SimState::forceInflow() writes over the post-collision populations of column 0.
+	double inflow[9];
+	for(int d = 0;d < 9;d++) {
+		double cu = dCol[d] * u0;
+		inflow[d] = weight[d] * (1 - 1.5*u0*u0 + 3*cu + 4.5*cu*cu);
+	}
+
+	for(int col = 0;col < width;col++) {
+		// Keep the old moments of this column before they are overwritten.
+		std::swap(previous, current);
+		for(int k = 0;k < 6;k++) {
+			std::memcpy(&current[k * height], fields[k]->colptr(col), height * sizeof(double));
+		}
+		if(col == 0) {
+			first = current;
+		}
+
+		// Old moments of the source columns: west (col - 1), here and east (col + 1).
+		int westCol = (col + width - 1) % width;
+		int eastCol = (col + 1) % width;
+		const double* m[3][6];
+		for(int k = 0;k < 6;k++) {
+			m[0][k] = col > 0 ? &previous[k * height]
+					: width > 1 ? fields[k]->colptr(westCol) : &current[k * height];
+			m[1][k] = &current[k * height];
+			m[2][k] = col < width - 1 ? fields[k]->colptr(eastCol) : &first[k * height];
+		}
+		const int sourceCol[3] = {westCol, col, eastCol};
+		const char* kindCol[3] = {&kind[(size_t)westCol * height], &kind[(size_t)col * height],
+								  &kind[(size_t)eastCol * height]};
+		// Columns that pull eastward or westward populations from column 0 see the in-flow.
+		const bool inflowSource = westCol == 0 || eastCol == 0;
+
+		double* __restrict__ outRho = rho.colptr(col);
+		double* __restrict__ outUx  = _ux.colptr(col);
+		double* __restrict__ outUy  = _uy.colptr(col);
+		double* __restrict__ outPxx = _pxx.colptr(col);
+		double* __restrict__ outPxy = _pxy.colptr(col);
+		double* __restrict__ outPyy = _pyy.colptr(col);
+
+		for(int row = 0;row < height;row++) {
+			if(kindCol[1][row] == BARRIER) {
+				continue;
+			}
+			int north = row + 1 == height ? 0 : row + 1;
+			int south = row == 0 ? height - 1 : row - 1;
+
+			// Pull what every neighbour sends here; from a barrier, what this cell sent it.
+			double f[9];
+			if(kindCol[1][row] == FLUID && !inflowSource) {
+				f[D0]  = rebuild(m[1], row,   D0,  keep);
+				f[DN]  = rebuild(m[1], south, DN,  keep);
+				f[DS]  = rebuild(m[1], north, DS,  keep);
+				f[DE]  = rebuild(m[0], row,   DE,  keep);
+				f[DW]  = rebuild(m[2], row,   DW,  keep);
+				f[DNE] = rebuild(m[0], south, DNE, keep);
+				f[DSE] = rebuild(m[0], north, DSE, keep);
+				f[DNW] = rebuild(m[2], south, DNW, keep);
+				f[DSW] = rebuild(m[2], north, DSW, keep);
+			} else {
+				for(int d = 0;d < 9;d++) {
+					int s = 1 - dCol[d];
+					int r = dRow[d] > 0 ? south : dRow[d] < 0 ? north : row;
+					int e = d;
+					if(kindCol[s][r] == BARRIER) {
+						s = 1;
+						r = row;
+						e = opposite[d];
+					}
+					f[d] = sourceCol[s] == 0 && dCol[e] != 0 ? inflow[e] : rebuild(m[s], r, e, keep);
+				}
+			}
+
+			double density = f[D0] + f[DN] + f[DS] + f[DE] + f[DW] + f[DNE] + f[DSE] + f[DNW] + f[DSW];
+			double vx = (f[DE] + f[DNE] + f[DSE] - f[DW] - f[DNW] - f[DSW]) / density;
+			double vy = (f[DN] + f[DNE] + f[DNW] - f[DS] - f[DSE] - f[DSW]) / density;
+
+			double ux2 = vx * vx;
+			double uy2 = vy * vy;
+			double u2 = ux2 + uy2;
+			double omu215 = 1 - 1.5*u2;
+			double uxuy = vx * vy;
+
+			double eqN  = one9th * density * (omu215 + 3*vy + 4.5*uy2);
+			double eqS  = one9th * density * (omu215 - 3*vy + 4.5*uy2);
+			double eqE  = one9th * density * (omu215 + 3*vx + 4.5*ux2);
+			double eqW  = one9th * density * (omu215 - 3*vx + 4.5*ux2);
+			double eqNE = one36th * density * (omu215 + 3*(vx+vy) + 4.5*(u2+2*uxuy));
+			double eqNW = one36th * density * (omu215 + 3*(-vx+vy) + 4.5*(u2-2*uxuy));
+			double eqSE = one36th * density * (omu215 + 3*(vx-vy) + 4.5*(u2-2*uxuy));
+			double eqSW = one36th * density * (omu215 + 3*(-vx-vy) + 4.5*(u2+2*uxuy));
+
+			double neqD1 = f[DNE] - eqNE + f[DSW] - eqSW;
+			double neqD2 = f[DNW] - eqNW + f[DSE] - eqSE;
+
+			outRho[row] = density;
+			outUx[row] = vx;
+			outUy[row] = vy;
+			outPxx[row] = f[DE] - eqE + f[DW] - eqW + neqD1 + neqD2;
+			outPyy[row] = f[DN] - eqN + f[DS] - eqS + neqD1 + neqD2;
+			outPxy[row] = neqD1 - neqD2;
+		}
+	}
+
+	_steps++;
+}
+
+int MomentLattice::steps() {
+	return _steps;
+}
+
+const arma::mat& MomentLattice::ux() {
+	return _ux;
+}
+
+const arma::mat& MomentLattice::uy() {
+	return _uy;
+}
+
+const arma::mat& MomentLattice::density() {
+	return rho;
+}
+
+/**
+ * @brief The current fields, as SimState::getFrame() would give them.
+ */
+Frame MomentLattice::getFrame() {
+	PROFILE_SCOPE("frame");
+	return Frame(height, width, barrier, _ux, _uy, rho);
+}
+
+/**
+ * @brief A SimState with collision model REGULARIZED that continues this run exactly, e.g. to
+ * save it.
+ */
+SimState MomentLattice::state() {
+	SimState s(height, width, 0.0, u0);
+	s.omega = omega;
+	s.barrier = barrier;
+	s._solidCells.clear();
+	for(int i = 0;i < height * width;i++) {
+		if(barrier[i]) {
+			s._solidCells.push_back(i);
+		}
+	}
+	s.started = _steps > 0;
+	s._steps = _steps;
+	s.setCollisionModel(SimState::REGULARIZED);
+
+	arma::mat* n[9] = {&s.n0, &s.nN, &s.nS, &s.nE, &s.nW, &s.nNE, &s.nSE, &s.nNW, &s.nSW};
+	const double keep = 1 - omega;
+
+	for(int col = 0;col < width;col++) {
+		const double* m[6] = {rho.colptr(col), _ux.colptr(col), _uy.colptr(col),
+							  _pxx.colptr(col), _pxy.colptr(col), _pyy.colptr(col)};
+		for(int row = 0;row < height;row++) {
+			for(int d = 0;d < 9;d++) {
+				(*n[d])(row, col) = rebuild(m, row, d, keep);
+			}
+		}
+	}
+	s.forceInflow();
+
+	FrameFields& fields = s.writeFields(false);
+	fields.density = rho;
+	fields.ux = _ux;
+	fields.uy = _uy;
+	s.frames.clear();
+	s.pushFrame(Frame(height, width, barrier, s._fields));
+	return s;
+}
@@ -0,0 +1,67 @@
+#ifndef MOMENTLATTICE_HPP
+#define MOMENTLATTICE_HPP
+
+#include "Frame.hpp"
+#include "SimState.hpp"
+
+#include <boost/shared_array.hpp>
+
+#include <vector>
+
+/**
+ * A lattice that stores moments instead of populations.
+ *
+ * Each cell keeps six values: density, velocity and the non-equilibrium stress Pi (xx, xy, yy),
+ * where SimState keeps nine populations plus density and velocity. A step pulls, for every cell,
+ * the nine populations its neighbours send it, rebuilt on the fly from their moments the way
+ * regularized collision rebuilds them (equilibrium plus (1 - omega) times the part of Pi the
+ * lattice can carry), and stores the moments of what arrived. Streaming and collision are one pass
+ * over memory and the velocity and density fields need no separate computation.
+ *
+ * The update runs in place column by column. Only three columns of old moments are kept aside:
+ * the one before, the current one and column 0, which the last column needs across the periodic
+ * edge.
+ *
+ * The dynamics are those of SimState with collision model REGULARIZED: half-way bounce-back on
+ * barriers, in-flow forced on column 0 and periodic edges. Moving obstacles and open boundaries
+ * are not supported. One difference: a barrier on the first or last column also bounces back
+ * what would cross the periodic edge through it, where SimState lets the barrier's own
+ * populations leak through, so walls along the top and bottom rows differ in their corner cells.
+ */
+class MomentLattice {
+	int height;
+	int width;
+	double omega;
+	double u0;
+
+	boost::shared_array<bool> barrier;
+	std::vector<char> kind;				// FLUID, NEAR_BARRIER or BARRIER, column-major like the fields
+
+	arma::mat rho;
+	arma::mat _ux;
+	arma::mat _uy;
+	arma::mat _pxx;						// non-equilibrium stress before collision
+	arma::mat _pxy;
+	arma::mat _pyy;
+
+	std::vector<double> first;			// 6 x height old moments of column 0
+	std::vector<double> previous;		// of the column before the current one
+	std::vector<double> current;		// of the current one
+
+	int _steps = 0;
+
+public:
+	explicit MomentLattice(const SimState& geometry);
+
+	void step();
+	int steps();
+
+	const arma::mat& ux();
+	const arma::mat& uy();
+	const arma::mat& density();
+
+	Frame getFrame();
+	SimState state();
+};
+
+#endif // MOMENTLATTICE_HPP
@@ -0,0 +1,546 @@
+#include "MultiBlock.hpp"
+#include "Lattice.hpp"
+#include "Profiler.hpp"
+
+#include <cassert>
+#include <cmath>
+
+using namespace lattice;
+
+/**
+ * @brief Equilibrium populations for a density and velocity.
+ */
+static inline void equilibrium(double density, double ux, double uy, double* feq) {
+	double omu215 = 1 - 1.5*(ux*ux + uy*uy);
+	for(int d = 0;d < 9;d++) {
+		double cu = dCol[d]*ux + dRow[d]*uy;
+		feq[d] = weight[d] * density * (omu215 + 3*cu + 4.5*cu*cu);
+	}
+}
+
+/**
+ * @brief Density and velocity of a cell.
+ */
+static inline void moments(const double* p, double& density, double& ux, double& uy) {
+	density = p[D0] + p[DN] + p[DS] + p[DE] + p[DW] + p[DNE] + p[DSE] + p[DNW] + p[DSW];
+	ux = (p[DE] + p[DNE] + p[DSE] - p[DW] - p[DNW] - p[DSW]) / density;
+	uy = (p[DN] + p[DNE] + p[DNW] - p[DS] - p[DSE] - p[DSW]) / density;
+}
+
+/**
+ * @brief Keeps the equilibrium part of p and scales the rest.
+ */
+static inline void rescale(double* p, double scale) {
+	double density;
+	double ux;
+	double uy;
+	double feq[9];
+	moments(p, density, ux, uy);
+	equilibrium(density, ux, uy, feq);
+	for(int d = 0;d < 9;d++) {
+		p[d] = feq[d] + scale * (p[d] - feq[d]);
+	}
+}
+
+/**
+ * @brief BGK collision of one cell, with the in-flow forced as in SimState::collide().
+ */
+static inline void collide(double* p, double omega, bool inflow, double u0,
+						   double& density, double& ux, double& uy) {
+	double feq[9];
+	moments(p, density, ux, uy);
+	equilibrium(density, ux, uy, feq);
+	for(int d = 0;d < 9;d++) {
+		p[d] += omega * (feq[d] - p[d]);
+	}
+
+	if(inflow) {
+		equilibrium(1, u0, 0, feq);
+		for(int d : {DE, DW, DNE, DSE, DNW, DSW}) {
+			p[d] = feq[d];
+		}
+	}
+}
+
+/**
+ * @brief Builds the lattice from a state at fine resolution, e.g. one just loaded.
+ *
+ * Blocks holding a barrier of the geometry, or next to one, are refined. Their populations are
+ * copied from the geometry; the coarse lattice starts as the average of the geometry's cells.
+ * The barrier array is shared with the geometry state and must not be edited afterwards.
+ *
+ * @param geometry	fine state, its size must pass fits()
+ * @param factor	fine cells per coarse cell along each axis, e.g. 2 or 4
+ * @param blockSize	coarse cells per block side
+ */
+MultiBlock::MultiBlock(const SimState& geometry, int factor, int blockSize) :
+	height(geometry.height),
+	width(geometry.width),
+	factor(factor),
+	blockSize(blockSize),
+	fineSize(factor * blockSize),
+	coarseHeight(geometry.height / factor),
+	coarseWidth(geometry.width / factor),
+	blockRows(geometry.height / (factor * blockSize)),
+	blockCols(geometry.width / (factor * blockSize)),
+	omegaFine(geometry.omega),
+	u0(geometry.u0),
+	barrier(geometry.barrier)
+{
+	assert(fits(height, width, factor, blockSize));
+
+	// Same physical viscosity on both lattices: nu_coarse = nu_fine / factor.
+	double viscosity = (1 / omegaFine - 0.5) / 3;
+	omegaCoarse = 1 / (3 * viscosity / factor + 0.5);
+
+	// Every population handed across the interface has just collided, which scaled its
+	// non-equilibrium part by 1 - omega = (tau - 1) / tau on its own lattice. Matching the stress
+	// then takes (tau_f - 1) / (factor (tau_c - 1)) rather than the ratio of relaxation times that
+	// applies before collision. At tau = 1 nothing is left to scale.
+	double keepFine = 1 / omegaFine - 1;
+	double keepCoarse = factor * (1 / omegaCoarse - 1);
+	toFine = std::abs(keepCoarse) > 1e-12 ? keepFine / keepCoarse : 0;
+	toCoarse = std::abs(keepFine) > 1e-12 ? keepCoarse / keepFine : 0;
+
+	const arma::mat* n[9];
+	geometry.populations(n);
+	const FrameFields& fields = geometry.fields();
+
+	// Refine every block with a barrier and its eight neighbours.
+	std::vector<char> refine(blockRows * blockCols, 0);
+	for(int row = 0;row < height;row++) {
+		for(int col = 0;col < width;col++) {
+			if(!barrier[row * width + col]) {
+				continue;
+			}
+			int br = row / fineSize;
+			int bc = col / fineSize;
+			for(int dr = -1;dr <= 1;dr++) {
+				for(int dc = -1;dc <= 1;dc++) {
+					int r = (br + dr + blockRows) % blockRows;
+					int c = (bc + dc + blockCols) % blockCols;
+					refine[r * blockCols + c] = 1;
+				}
+			}
+		}
+	}
+
+	int stride = fineSize + 2;
+	blockIndex.assign(blockRows * blockCols, -1);
+	for(int i = 0;i < blockRows * blockCols;i++) {
+		if(!refine[i]) {
+			continue;
+		}
+		blockIndex[i] = blocks.size();
+
+		Block b;
+		b.row = i / blockCols;
+		b.col = i % blockCols;
+		b.inflow = b.col == 0;
+		for(int d = 0;d < 9;d++) {
+			b.f[d].assign(stride * stride, 0.0);
+			b.next[d].assign(stride * stride, 0.0);
+		}
+		b.solid.assign(stride * stride, 0);
+		b.rho.resize(fineSize * fineSize);
+		b.ux.resize(fineSize * fineSize);
+		b.uy.resize(fineSize * fineSize);
+
+		for(int r = -1;r <= fineSize;r++) {
+			for(int c = -1;c <= fineSize;c++) {
+				int row = (b.row * fineSize + r + height) % height;
+				int col = (b.col * fineSize + c + width) % width;
+				int k = (r + 1) * stride + c + 1;
+				b.solid[k] = barrier[row * width + col];
+				for(int d = 0;d < 9;d++) {
+					b.f[d][k] = (*n[d])(row, col);
+				}
+			}
+		}
+		for(int r = 0;r < fineSize;r++) {
+			for(int c = 0;c < fineSize;c++) {
+				int row = b.row * fineSize + r;
+				int col = b.col * fineSize + c;
+				b.rho[r * fineSize + c] = fields.density(row, col);
+				b.ux[r * fineSize + c] = fields.ux(row, col);
+				b.uy[r * fineSize + c] = fields.uy(row, col);
+			}
+		}
+		blocks.push_back(std::move(b));
+	}
+
+	size_t cells = (size_t)coarseHeight * coarseWidth;
+	for(int d = 0;d < 9;d++) {
+		coarse[d].resize(cells);
+		previous[d].resize(cells);
+		scratch[d].resize(cells);
+	}
+	rho.resize(cells);
+	_ux.resize(cells);
+	_uy.resize(cells);
+
+	for(int row = 0;row < coarseHeight;row++) {
+		for(int col = 0;col < coarseWidth;col++) {
+			double p[9] = {0};
+			for(int r = 0;r < factor;r++) {
+				for(int c = 0;c < factor;c++) {
+					for(int d = 0;d < 9;d++) {
+						p[d] += (*n[d])(row * factor + r, col * factor + c);
+					}
+				}
+			}
+			for(int d = 0;d < 9;d++) {
+				p[d] /= factor * factor;
+			}
+			rescale(p, toCoarse);
+
+			size_t i = (size_t)row * coarseWidth + col;
+			for(int d = 0;d < 9;d++) {
+				coarse[d][i] = p[d];
+			}
+			moments(p, rho[i], _ux[i], _uy[i]);
+		}
+	}
+}
+
+/**
+ * @brief Whether a domain can be cut into blocks.
+ * @return true if height and width are multiples of factor * blockSize
+ */
+bool MultiBlock::fits(int height, int width, int factor, int blockSize) {
+	int size = factor * blockSize;
+	return factor >= 1 && blockSize >= 1 && height % size == 0 && width % size == 0;
+}
+
+/**
+ * @brief Advances one coarse step, which is factor steps of the geometry's resolution.
+ */
+void MultiBlock::step() {
+	PROFILE_SCOPE_CELLS("step", (long)(cellsPerStep() * factor));
+
+	stepCoarse();
+
+	{
+		PROFILE_SCOPE("fine");
+		for(int k = 0;k < factor;k++) {
+			for(auto& b : blocks) {
+				fillHalo(b, (double)k / factor);
+			}
+			for(auto& b : blocks) {
+				stepBlock(b);
+			}
+		}
+	}
+
+	for(auto& b : blocks) {
+		coarsen(b);
+	}
+
+	_steps += factor;
+}
+
+/**
+ * @brief MultiBlock::steps
+ * @return the number of steps taken, counted at the geometry's resolution
+ */
+int MultiBlock::steps() {
+	return _steps;
+}
+
+/**
+ * @brief MultiBlock::refinedBlocks
+ * @return the number of fine blocks
+ */
+int MultiBlock::refinedBlocks() {
+	return blocks.size();
+}
+
+/**
+ * @brief Work per step of the geometry's resolution, in cell updates. A uniform lattice needs
+ * height * width.
+ */
+double MultiBlock::cellsPerStep() {
+	return (double)coarseHeight * coarseWidth / factor + (double)blocks.size() * fineSize * fineSize;
+}
+
+/**
+ * @brief Streams (periodic, no barriers) and collides the whole coarse lattice. Cells under fine
+ * blocks are stepped too and overwritten by coarsen() afterwards.
+ */
+void MultiBlock::stepCoarse() {
+	PROFILE_SCOPE("coarse");
+
+	for(int d = 0;d < 9;d++) {
+		previous[d] = coarse[d];
+	}
+
+	for(int row = 0;row < coarseHeight;row++) {
+		for(int col = 0;col < coarseWidth;col++) {
+			size_t i = (size_t)row * coarseWidth + col;
+			double p[9];
+			for(int d = 0;d < 9;d++) {
+				int r = (row - dRow[d] + coarseHeight) % coarseHeight;
+				int c = (col - dCol[d] + coarseWidth) % coarseWidth;
+				p[d] = coarse[d][(size_t)r * coarseWidth + c];
+			}
+			collide(p, omegaCoarse, col == 0, u0, rho[i], _ux[i], _uy[i]);
+			for(int d = 0;d < 9;d++) {
+				scratch[d][i] = p[d];
+			}
+		}
+	}
+
+	for(int d = 0;d < 9;d++) {
+		coarse[d].swap(scratch[d]);
+	}
+}
+
+/**
+ * @brief Coarse populations at a point between coarse cell centres, rescaled for the fine lattice.
+ *
+ * @param row	position in coarse cells (cell centres are at integers), wraps around
+ * @param col
+ * @param t		time between the previous (0) and the current (1) coarse step
+ * @param out	9 populations
+ */
+void MultiBlock::interpolate(double row, double col, double t, double* out) {
+	int r0 = (int)std::floor(row);
+	int c0 = (int)std::floor(col);
+	double fr = row - r0;
+	double fc = col - c0;
+	int r1 = (r0 + 1 + coarseHeight) % coarseHeight;
+	int c1 = (c0 + 1 + coarseWidth) % coarseWidth;
+	r0 = (r0 + coarseHeight) % coarseHeight;
+	c0 = (c0 + coarseWidth) % coarseWidth;
+
+	size_t i00 = (size_t)r0 * coarseWidth + c0;
+	size_t i01 = (size_t)r0 * coarseWidth + c1;
+	size_t i10 = (size_t)r1 * coarseWidth + c0;
+	size_t i11 = (size_t)r1 * coarseWidth + c1;
+	double w00 = (1 - fr) * (1 - fc);
+	double w01 = (1 - fr) * fc;
+	double w10 = fr * (1 - fc);
+	double w11 = fr * fc;
+
+	for(int d = 0;d < 9;d++) {
+		double before = w00*previous[d][i00] + w01*previous[d][i01] + w10*previous[d][i10] + w11*previous[d][i11];
+		double after  = w00*coarse[d][i00] + w01*coarse[d][i01] + w10*coarse[d][i10] + w11*coarse[d][i11];
+		out[d] = before + t * (after - before);
+	}
+	rescale(out, toFine);
+}
+
+/**
+ * @brief Sets the halo of a block to the populations of its neighbours at sub-step time t.
+ */
+void MultiBlock::fillHalo(Block& block, double t) {
+	const int n = fineSize;
+	const int stride = n + 2;
+
+	for(int r = -1;r <= n;r++) {
+		for(int c = -1;c <= n;c++) {
+			if(r >= 0 && r < n && c >= 0 && c < n) {
+				c = n - 1;		// skip the interior
+				continue;
+			}
+
+			int row = (block.row * n + r + height) % height;
+			int col = (block.col * n + c + width) % width;
+			int k = (r + 1) * stride + c + 1;
+
+			int other = blockIndex[(row / n) * blockCols + col / n];
+			if(other >= 0) {
+				const Block& b = blocks[other];
+				int j = (row - b.row * n + 1) * stride + (col - b.col * n + 1);
+				for(int d = 0;d < 9;d++) {
+					block.f[d][k] = b.f[d][j];
+				}
+			} else {
+				double p[9];
+				interpolate((row + 0.5) / factor - 0.5, (col + 0.5) / factor - 0.5, t, p);
+				for(int d = 0;d < 9;d++) {
+					block.f[d][k] = p[d];
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief One fine step of a block: pull streaming with halfway bounce-back, then collision.
+ */
+void MultiBlock::stepBlock(Block& block) {
+	const int n = fineSize;
+	const int stride = n + 2;
+
+	for(int r = 0;r < n;r++) {
+		for(int c = 0;c < n;c++) {
+			int k = (r + 1) * stride + c + 1;
+			if(block.solid[k]) {
+				for(int d = 0;d < 9;d++) {
+					block.next[d][k] = block.f[d][k];
+				}
+				continue;
+			}
+
+			// A population that would come from a barrier is the one this cell sent into it.
+			double p[9];
+			for(int d = 0;d < 9;d++) {
+				int from = k - dRow[d] * stride - dCol[d];
+				p[d] = block.solid[from] ? block.f[opposite[d]][k] : block.f[d][from];
+			}
+
+			int i = r * n + c;
+			collide(p, omegaFine, block.inflow && c == 0, u0, block.rho[i], block.ux[i], block.uy[i]);
+			for(int d = 0;d < 9;d++) {
+				block.next[d][k] = p[d];
+			}
+		}
+	}
+
+	for(int d = 0;d < 9;d++) {
+		block.f[d].swap(block.next[d]);
+	}
+}
+
+/**
+ * @brief Overwrites the coarse cells under a block with the average of its fine cells.
+ */
+void MultiBlock::coarsen(Block& block) {
+	const int stride = fineSize + 2;
+
+	for(int row = 0;row < blockSize;row++) {
+		for(int col = 0;col < blockSize;col++) {
+			double p[9] = {0};
+			for(int r = 0;r < factor;r++) {
+				for(int c = 0;c < factor;c++) {
+					int k = (row * factor + r + 1) * stride + col * factor + c + 1;
+					for(int d = 0;d < 9;d++) {
+						p[d] += block.f[d][k];
+					}
+				}
+			}
+			for(int d = 0;d < 9;d++) {
+				p[d] /= factor * factor;
+			}
+			rescale(p, toCoarse);
+
+			size_t i = (size_t)(block.row * blockSize + row) * coarseWidth + block.col * blockSize + col;
+			for(int d = 0;d < 9;d++) {
+				coarse[d][i] = p[d];
+			}
+			moments(p, rho[i], _ux[i], _uy[i]);
+		}
+	}
+}
+
+/**
+ * @brief Samples the current fields on a uniform grid, so the result can be shown like any frame.
+ *
+ * Each display cell takes the value of the fine cell at its centre, or where that is not refined,
+ * the coarse fields interpolated there.
+ *
+ * @param displayHeight	rows of the frame, -1 for the geometry's resolution
+ * @param displayWidth	columns of the frame, -1 for the geometry's resolution
+ */
+Frame MultiBlock::getFrame(int displayHeight, int displayWidth) {
+	PROFILE_SCOPE("frame");
+
+	int h = displayHeight > 0 ? displayHeight : height;
+	int w = displayWidth > 0 ? displayWidth : width;
+
+	arma::mat ux(h, w);
+	arma::mat uy(h, w);
+	arma::mat density(h, w);
+	boost::shared_array<bool> barriers = barrier;
+	if(h != height || w != width) {
+		barriers = boost::shared_array<bool>(new bool[h * w]);
+	}
+
+	for(int r = 0;r < h;r++) {
+		int row = std::min(height - 1, (int)((r + 0.5) * height / h));
+		for(int c = 0;c < w;c++) {
+			int col = std::min(width - 1, (int)((c + 0.5) * width / w));
+			if(h != height || w != width) {
+				barriers[r * w + c] = barrier[row * width + col];
+			}
+
+			int b = blockIndex[(row / fineSize) * blockCols + col / fineSize];
+			if(b >= 0) {
+				int i = (row - blocks[b].row * fineSize) * fineSize + col - blocks[b].col * fineSize;
+				density(r, c) = blocks[b].rho[i];
+				ux(r, c) = blocks[b].ux[i];
+				uy(r, c) = blocks[b].uy[i];
+				continue;
+			}
+
+			// Bilinear in the coarse fields; neighbours of an unrefined block are never barriers.
+			double y = (row + 0.5) / factor - 0.5;
+			double x = (col + 0.5) / factor - 0.5;
+			int r0 = (int)std::floor(y);
+			int c0 = (int)std::floor(x);
+			double fr = y - r0;
+			double fc = x - c0;
+			int r1 = (r0 + 1 + coarseHeight) % coarseHeight;
+			int c1 = (c0 + 1 + coarseWidth) % coarseWidth;
+			r0 = (r0 + coarseHeight) % coarseHeight;
+			c0 = (c0 + coarseWidth) % coarseWidth;
+			size_t i00 = (size_t)r0 * coarseWidth + c0;
+			size_t i01 = (size_t)r0 * coarseWidth + c1;
+			size_t i10 = (size_t)r1 * coarseWidth + c0;
+			size_t i11 = (size_t)r1 * coarseWidth + c1;
+			auto sample = [&](const std::vector<double>& v) {
+				return (1 - fr) * ((1 - fc) * v[i00] + fc * v[i01]) + fr * ((1 - fc) * v[i10] + fc * v[i11]);
+			};
+			density(r, c) = sample(rho);
+			ux(r, c) = sample(_ux);
+			uy(r, c) = sample(_uy);
+		}
+	}
+
+	return Frame(h, w, barriers, ux, uy, density);
+}
+
+/**
+ * @brief Resamples the whole lattice at the geometry's resolution, e.g. to save it.
+ */
+SimState MultiBlock::state() {
+	SimState s(height, width, 0.0, u0);
+	s.omega = omegaFine;
+	s.barrier = barrier;
+	s._solidCells.clear();
+	for(int i = 0;i < height * width;i++) {
+		if(barrier[i]) {
+			s._solidCells.push_back(i);
+		}
+	}
+	s.started = _steps > 0;
+	s._steps = _steps;
+
+	arma::mat* n[9] = {&s.n0, &s.nN, &s.nS, &s.nE, &s.nW, &s.nNE, &s.nSE, &s.nNW, &s.nSW};
+	FrameFields& fields = s.writeFields(false);
+	const int stride = fineSize + 2;
+
+	for(int row = 0;row < height;row++) {
+		for(int col = 0;col < width;col++) {
+			double p[9];
+			int b = blockIndex[(row / fineSize) * blockCols + col / fineSize];
+			if(b >= 0) {
+				int k = (row - blocks[b].row * fineSize + 1) * stride + col - blocks[b].col * fineSize + 1;
+				for(int d = 0;d < 9;d++) {
+					p[d] = blocks[b].f[d][k];
+				}
+			} else {
+				interpolate((row + 0.5) / factor - 0.5, (col + 0.5) / factor - 0.5, 1, p);
+			}
+			for(int d = 0;d < 9;d++) {
+				(*n[d])(row, col) = p[d];
+			}
+			moments(p, fields.density(row, col), fields.ux(row, col), fields.uy(row, col));
+		}
+	}
+
+	s.frames.clear();
+	s.pushFrame(Frame(height, width, barrier, s._fields));
+	return s;
+}
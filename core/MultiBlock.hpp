@@ -0,0 +1,97 @@
+#ifndef MULTIBLOCK_HPP
+#define MULTIBLOCK_HPP
+
+#include "Frame.hpp"
+#include "SimState.hpp"
+
+#include <boost/shared_array.hpp>
+
+#include <vector>
+
+/**
+ * A lattice that is only fine near barriers.
+ *
+ * The domain is covered by a coarse lattice with factor times the spacing of the geometry state,
+ * cut into square blocks of blockSize x blockSize coarse cells. Every block that holds a barrier,
+ * and every block next to one, is replaced by a fine block at the resolution of the geometry.
+ * Fine blocks take factor steps per coarse step (acoustic scaling: dx and dt both shrink by
+ * factor, so velocities carry over and the lattice viscosity grows by factor).
+ *
+ * Each fine block has a one cell halo. Halo cells inside another fine block are copied from it;
+ * the others are interpolated from the coarse lattice, bilinearly in space and linearly in time
+ * between the coarse step before and after. Going from coarse to fine and back, the
+ * non-equilibrium part of the populations is rescaled so the stress is continuous (Dupuis and
+ * Chopard, 2003); the populations exchanged are post-collision, so the factor is
+ * (tau_f - 1) / (factor (tau_c - 1)). After the fine sub-steps, coarse cells under a
+ * fine block are overwritten by the average of the fine cells they cover.
+ *
+ * Barriers only exist on the fine lattice. Collision is BGK, with the in-flow on column 0 forced
+ * as in SimState and periodic edges. Moving obstacles and open boundaries are not supported.
+ */
+class MultiBlock {
+	struct Block {
+		int row;						// position in blocks
+		int col;
+		bool inflow;					// holds column 0 of the domain
+		std::vector<double> f[9];		// (n + 2)^2 populations with halo, row-major
+		std::vector<double> next[9];
+		std::vector<char> solid;		// (n + 2)^2, halo included
+		std::vector<double> rho;		// n^2, row-major
+		std::vector<double> ux;
+		std::vector<double> uy;
+	};
+
+	int height;							// resolution of the geometry (the fine lattice)
+	int width;
+	int factor;
+	int blockSize;						// coarse cells per block side
+	int fineSize;						// fine cells per block side
+	int coarseHeight;
+	int coarseWidth;
+	int blockRows;
+	int blockCols;
+
+	double omegaFine;
+	double omegaCoarse;
+	double u0;
+	double toFine;						// non-equilibrium scale coarse -> fine
+	double toCoarse;					// and back
+
+	boost::shared_array<bool> barrier;
+
+	// Coarse lattice, row-major. previous holds the populations before the last coarse step for
+	// the time interpolation of the halos.
+	std::vector<double> coarse[9];
+	std::vector<double> previous[9];
+	std::vector<double> scratch[9];
+	std::vector<double> rho;
+	std::vector<double> _ux;
+	std::vector<double> _uy;
+
+	std::vector<Block> blocks;
+	std::vector<int> blockIndex;		// blockRows x blockCols, index into blocks or -1
+
+	int _steps = 0;						// in fine steps
+
+	void stepCoarse();
+	void fillHalo(Block& block, double t);
+	void stepBlock(Block& block);
+	void coarsen(Block& block);
+	void interpolate(double row, double col, double t, double* out);
+
+public:
+	MultiBlock(const SimState& geometry, int factor, int blockSize = 8);
+
+	static bool fits(int height, int width, int factor, int blockSize);
+
+	void step();
+	int steps();
+
+	int refinedBlocks();
+	double cellsPerStep();
+
+	Frame getFrame(int displayHeight = -1, int displayWidth = -1);
+	SimState state();
+};
+
+#endif // MULTIBLOCK_HPP
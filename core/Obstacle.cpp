@@ -0,0 +1,47 @@
+#include "Obstacle.hpp"
+
+#include <cmath>
+
+static constexpr double PI = 3.14159265358979323846;
+
+Obstacle::Obstacle(const Shape& shape, double x, double y) : shape(shape), x(x), y(y) {
+}
+
+/**
+ * @brief Position and rotation of the shape at time t.
+ */
+void Obstacle::pose(double t, double& px, double& py, double& pangle) const {
+	px = x + vx * t;
+	py = y + vy * t;
+	pangle = angle + angularVelocity * t;
+	if(period > 0) {
+		pangle += amplitude * std::sin(2 * PI * t / period);
+	}
+}
+
+/**
+ * @brief Velocity of the solid at a point, used for moving-wall bounce-back.
+ */
+void Obstacle::velocity(double t, double col, double row, double& ux, double& uy) const {
+	double px, py, pangle;
+	pose(t, px, py, pangle);
+
+	double w = angularVelocity;
+	if(period > 0) {
+		w += amplitude * 2 * PI / period * std::cos(2 * PI * t / period);
+	}
+
+	// v + w x r, with w perpendicular to the lattice
+	ux = vx - w * (row - py);
+	uy = vy + w * (col - px);
+}
+
+/**
+ * @brief Obstacle::cells
+ * @return sorted row-major indices of the cells covered at time t
+ */
+std::vector<int> Obstacle::cells(int rows, int cols, double t) const {
+	double px, py, pangle;
+	pose(t, px, py, pangle);
+	return shape.cells(rows, cols, px, py, pangle);
+}
@@ -0,0 +1,34 @@
+#ifndef OBSTACLE_HPP
+#define OBSTACLE_HPP
+
+#include "Shape.hpp"
+
+/**
+ * A solid that moves along a prescribed trajectory, e.g. a stirrer or a flapping plate.
+ *
+ * Positions are in cells and times in steps. The shape turns about its own origin with a constant
+ * rate plus an optional sinusoidal swing, while the origin translates at constant velocity.
+ */
+class Obstacle {
+public:
+	Shape shape;
+
+	double x;					// column of the shape origin at step 0
+	double y;					// row of the shape origin at step 0
+	double angle = 0;			// rotation at step 0, radians
+
+	double vx = 0;				// translation, cells per step
+	double vy = 0;
+	double angularVelocity = 0;	// radians per step
+
+	double amplitude = 0;		// swing amplitude in radians, added on top of the rotation
+	double period = 0;			// swing period in steps, 0 for none
+
+	Obstacle(const Shape& shape, double x, double y);
+
+	void pose(double t, double& px, double& py, double& pangle) const;
+	void velocity(double t, double col, double row, double& ux, double& uy) const;
+	std::vector<int> cells(int rows, int cols, double t) const;
+};
+
+#endif // OBSTACLE_HPP
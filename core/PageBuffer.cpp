@@ -0,0 +1,105 @@
+#include "PageBuffer.hpp"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <utility>
+
+// Size of a transparent huge page on x86-64 and most arm64 kernels.
+static constexpr std::size_t HUGE_PAGE = 2 << 20;
+
+PageBuffer::~PageBuffer() {
+	release();
+}
+
+PageBuffer::PageBuffer(PageBuffer&& other) {
+	*this = std::move(other);
+}
+
+PageBuffer& PageBuffer::operator=(PageBuffer&& other) {
+	if(this != &other) {
+		release();
+		std::swap(_memory, other._memory);
+		std::swap(_size, other._size);
+		std::swap(_mapped, other._mapped);
+	}
+	return *this;
+}
+
+/**
+ * @brief Maps `bytes` of fresh memory, dropping what the buffer held before. No page is touched.
+ * @param hugePages	align to 2 MiB and ask for transparent huge pages, which cuts TLB misses on
+ *					large lattices; the kernel may still back some of it with small pages
+ * @return false if the memory could not be mapped
+ */
+bool PageBuffer::allocate(std::size_t bytes, bool hugePages) {
+	release();
+	if(bytes == 0) {
+		return true;
+	}
+
+	std::size_t length = hugePages ? bytes + HUGE_PAGE : bytes;
+	void* memory = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(memory == MAP_FAILED) {
+		return false;
+	}
+
+	if(hugePages) {
+		// Trim the mapping to start on a huge page boundary.
+		std::uintptr_t start = (std::uintptr_t)memory;
+		std::uintptr_t aligned = (start + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+		if(aligned > start) {
+			munmap(memory, aligned - start);
+		}
+		std::size_t page = sysconf(_SC_PAGESIZE);
+		std::size_t kept = (bytes + page - 1) / page * page;
+		std::uintptr_t end = start + length;
+		if(aligned + kept < end) {
+			munmap((void*)(aligned + kept), end - aligned - kept);
+		}
+		memory = (void*)aligned;
+		length = kept;
+		adviseHugePages(memory, length);
+	}
+
+	_memory = memory;
+	_size = bytes;
+	_mapped = length;
+	return true;
+}
+
+/**
+ * @brief Unmaps the memory.
+ */
+void PageBuffer::release() {
+	if(_memory) {
+		munmap(_memory, _mapped);
+	}
+	_memory = nullptr;
+	_size = 0;
+	_mapped = 0;
+}
+
+std::size_t PageBuffer::size() const {
+	return _size;
+}
+
+/**
+ * @brief Asks for transparent huge pages on the whole pages inside a block of memory, e.g. the
+ * storage of an arma::mat. Only takes effect on pages not yet touched; does nothing where the
+ * kernel lacks the feature.
+ */
+void PageBuffer::adviseHugePages(void* memory, std::size_t bytes) {
+#ifdef MADV_HUGEPAGE
+	std::size_t page = sysconf(_SC_PAGESIZE);
+	std::uintptr_t start = ((std::uintptr_t)memory + page - 1) / page * page;
+	std::uintptr_t end = ((std::uintptr_t)memory + bytes) / page * page;
+	if(end > start) {
+		madvise((void*)start, end - start, MADV_HUGEPAGE);
+	}
+#else
+	(void)memory;
+	(void)bytes;
+#endif
+}
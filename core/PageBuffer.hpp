@@ -0,0 +1,39 @@
+#ifndef PAGE_BUFFER_HPP
+#define PAGE_BUFFER_HPP
+
+#include <cstddef>
+
+/**
+ * Anonymous memory mapped straight from the kernel and left untouched.
+ *
+ * Unlike a std::vector, allocating does not write to the memory, so each page lands on the NUMA
+ * node of the thread that first writes to it (Linux first-touch placement). Filling the buffer
+ * from the threads that will later work on each part of it keeps their accesses node-local.
+ */
+class PageBuffer {
+	void* _memory = nullptr;
+	std::size_t _size = 0;		// bytes requested
+	std::size_t _mapped = 0;	// bytes mapped, from _memory
+
+public:
+	PageBuffer() = default;
+	~PageBuffer();
+
+	PageBuffer(const PageBuffer&) = delete;
+	PageBuffer& operator=(const PageBuffer&) = delete;
+	PageBuffer(PageBuffer&& other);
+	PageBuffer& operator=(PageBuffer&& other);
+
+	bool allocate(std::size_t bytes, bool hugePages = false);
+	void release();
+	std::size_t size() const;
+
+	template<typename T>
+	T* data() const {
+		return static_cast<T*>(_memory);
+	}
+
+	static void adviseHugePages(void* memory, std::size_t bytes);
+};
+
+#endif // PAGE_BUFFER_HPP
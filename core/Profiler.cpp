@@ -0,0 +1,275 @@
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+
+#include <algorithm>
+#include <fstream>
+
+constexpr size_t Profiler::WINDOW;
+constexpr size_t Profiler::HISTORY;
+
+static thread_local bool threadEnabled = true;
+
+Profiler::Series::Series(const std::string& name, size_t history) :
+	_name(name),
+	_history(history),
+	_window(WINDOW) {
+}
+
+/**
+ * @brief Adds a sample to the series.
+ * @param start		seconds since the profiler was created
+ * @param duration	length of the sample in seconds
+ * @param cells		lattice cells processed during the sample
+ */
+void Profiler::Series::record(double start, double duration, long cells) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	Sample s = {start, duration, cells};
+	if(_samples.full() && _samples.capacity() < _history) {
+		_samples.set_capacity(std::min(std::max<size_t>(256, 2 * _samples.capacity()), _history));
+	}
+	if(_samples.capacity() > 0) {
+		_samples.push_back(s);
+	}
+
+	if(_window.full()) {
+		const Sample& old = _window.front();
+		if(old.cells > 0) {
+			_windowCells -= old.cells;
+			_windowTime -= old.duration;
+		}
+	}
+	_window.push_back(s);
+	if(cells > 0) {
+		_windowCells += cells;
+		_windowTime += duration;
+	}
+}
+
+/**
+ * @brief Profiler::Series::stats
+ * @return statistics over the most recent samples
+ */
+Profiler::Stats Profiler::Series::stats() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	Stats stats;
+	stats.count = _window.size();
+	if(stats.count == 0) {
+		return stats;
+	}
+
+	std::vector<double> durations;
+	durations.reserve(_window.size());
+	double sum = 0;
+	for(auto& s : _window) {
+		durations.push_back(s.duration);
+		sum += s.duration;
+	}
+
+	auto percentile = [&durations](double p) {
+		auto nth = durations.begin() + (size_t)(p * (durations.size() - 1));
+		std::nth_element(durations.begin(), nth, durations.end());
+		return *nth;
+	};
+
+	stats.mean = sum / durations.size() * 1e3;
+	stats.p50 = percentile(0.50) * 1e3;
+	stats.p99 = percentile(0.99) * 1e3;
+	if(_windowTime > 0) {
+		stats.mlups = _windowCells / _windowTime / 1e6;
+	}
+
+	return stats;
+}
+
+const std::string& Profiler::Series::name() const {
+	return _name;
+}
+
+Profiler::Profiler() : _epoch(std::chrono::steady_clock::now()) {
+}
+
+/**
+ * @brief Profiler::instance
+ * @return the process-wide profiler
+ */
+Profiler& Profiler::instance() {
+	static Profiler profiler;
+	return profiler;
+}
+
+/**
+ * @brief Finds or creates the series with the given name.
+ *
+ * The returned pointer stays valid for the life of the process, so call sites can cache it.
+ */
+Profiler::Series* Profiler::series(const std::string& name) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for(auto& s : _series) {
+		if(s->_name == name) {
+			return s.get();
+		}
+	}
+
+	_series.emplace_back(new Series(name, _history));
+	return _series.back().get();
+}
+
+/**
+ * @brief Profiler::names
+ * @return the names of every series, in order of creation
+ */
+std::vector<std::string> Profiler::names() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	std::vector<std::string> names;
+	for(auto& s : _series) {
+		names.push_back(s->_name);
+	}
+	return names;
+}
+
+/**
+ * @brief Profiler::stats
+ * @return the current statistics of a series, empty if nothing was recorded under that name
+ */
+Profiler::Stats Profiler::stats(const std::string& name) {
+	return series(name)->stats();
+}
+
+/**
+ * @brief Profiler::now
+ * @return seconds since the profiler was created
+ */
+double Profiler::now() {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - _epoch).count();
+}
+
+/**
+ * @brief Drops every recorded sample. Series stay registered.
+ */
+void Profiler::clear() {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	for(auto& s : _series) {
+		std::lock_guard<std::mutex> seriesLock(s->_mutex);
+		s->_samples.clear();
+		s->_window.clear();
+		s->_windowCells = 0;
+		s->_windowTime = 0;
+	}
+}
+
+/**
+ * @brief Turns recording off or back on for the calling thread.
+ *
+ * Threads that each run their own simulation, like Sweep's workers, would otherwise contend for
+ * the same series on every step and mix all their simulations into one. Trace events are still
+ * recorded.
+ */
+void Profiler::setThreadEnabled(bool enabled) {
+	threadEnabled = enabled;
+}
+
+/**
+ * @brief Sets how many of the most recent samples of each series are kept for export
+ * (HISTORY by default), e.g. enough for every step of a run whose timings are written out.
+ * Lowering it drops the oldest samples now.
+ */
+void Profiler::setHistory(size_t samples) {
+	std::lock_guard<std::mutex> lock(_mutex);
+
+	_history = samples;
+	for(auto& s : _series) {
+		std::lock_guard<std::mutex> seriesLock(s->_mutex);
+		s->_history = samples;
+		if(s->_samples.capacity() > samples) {
+			s->_samples.rset_capacity(samples);
+		}
+	}
+}
+
+/**
+ * @brief Writes every kept sample as CSV, one row per sample.
+ * @return false if the file could not be written
+ */
+bool Profiler::writeCsv(const std::string& path) {
+	std::ofstream out(path);
+	if(!out) {
+		return false;
+	}
+
+	out << "series,start_s,duration_ms,cells\n";
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	for(auto& s : _series) {
+		std::lock_guard<std::mutex> seriesLock(s->_mutex);
+		for(auto& sample : s->_samples) {
+			out << s->_name << "," << sample.start << "," << sample.duration * 1e3 << ","
+				<< sample.cells << "\n";
+		}
+	}
+
+	return bool(out);
+}
+
+/**
+ * @brief Writes the summary statistics and every kept sample as JSON.
+ * @return false if the file could not be written
+ */
+bool Profiler::writeJson(const std::string& path) {
+	std::ofstream out(path);
+	if(!out) {
+		return false;
+	}
+
+	std::vector<Series*> series;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		for(auto& s : _series) {
+			series.push_back(s.get());
+		}
+	}
+
+	out << "{\n";
+	for(size_t i = 0;i < series.size();i++) {
+		Series* s = series[i];
+		Stats stats = s->stats();
+
+		out << "  \"" << s->_name << "\": {\"count\": " << stats.count
+			<< ", \"mean_ms\": " << stats.mean
+			<< ", \"p50_ms\": " << stats.p50
+			<< ", \"p99_ms\": " << stats.p99
+			<< ", \"mlups\": " << stats.mlups
+			<< ", \"samples\": [";
+
+		std::lock_guard<std::mutex> seriesLock(s->_mutex);
+		for(size_t j = 0;j < s->_samples.size();j++) {
+			const Sample& sample = s->_samples[j];
+			out << (j ? ", " : "") << "[" << sample.start << ", " << sample.duration * 1e3 << ", "
+				<< sample.cells << "]";
+		}
+		out << "]}" << (i + 1 < series.size() ? "," : "") << "\n";
+	}
+	out << "}\n";
+
+	return bool(out);
+}
+
+ScopedTimer::ScopedTimer(Profiler::Series* series, long cells) :
+	_series(series), _cells(cells), _start(Profiler::instance().now()) {
+}
+
+ScopedTimer::~ScopedTimer() {
+	double end = Profiler::instance().now();
+	if(threadEnabled) {
+		_series->record(_start, end - _start, _cells);
+	}
+
+	// Timed phases double as trace events; the series name lives as long as the process.
+	if(Tracer::instance().enabled()) {
+		Tracer::instance().record(_series->name().c_str(), _start, end);
+	}
+}
@@ -0,0 +1,111 @@
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <boost/circular_buffer.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Collects wall-clock timings of named phases (stream, collide, draw, ...).
+ *
+ * The most recent samples of each series are kept for export, HISTORY of them unless
+ * setHistory() says otherwise; older ones are overwritten, so a long run neither grows without
+ * bound nor allocates once the history is full. The summary statistics only look at the most
+ * recent WINDOW samples so they follow what the simulation is doing right now.
+ */
+class Profiler {
+public:
+	static constexpr size_t WINDOW = 1000;
+	static constexpr size_t HISTORY = 100000;
+
+	struct Sample {
+		double start;		// seconds since the profiler was created
+		double duration;	// seconds
+		long cells;			// lattice cells processed, 0 if not applicable
+	};
+
+	struct Stats {
+		size_t count = 0;	// samples in the window
+		double mean = 0;	// milliseconds
+		double p50 = 0;
+		double p99 = 0;
+		double mlups = 0;	// million lattice updates per second, 0 if no cells were recorded
+	};
+
+	class Series {
+		friend class Profiler;
+
+		std::string _name;
+		std::mutex _mutex;
+		boost::circular_buffer<Sample> _samples;	// grows up to _history, then wraps
+		size_t _history;
+		boost::circular_buffer<Sample> _window;
+		long _windowCells = 0;
+		double _windowTime = 0;
+
+	public:
+		Series(const std::string& name, size_t history);
+
+		void record(double start, double duration, long cells);
+		Stats stats();
+		const std::string& name() const;
+	};
+
+private:
+	std::chrono::steady_clock::time_point _epoch;
+	std::mutex _mutex;
+	std::vector<std::unique_ptr<Series>> _series;
+	size_t _history = HISTORY;
+
+	Profiler();
+
+public:
+	static Profiler& instance();
+
+	Series* series(const std::string& name);
+	std::vector<std::string> names();
+	Stats stats(const std::string& name);
+
+	double now();
+	void clear();
+	void setHistory(size_t samples);
+
+	static void setThreadEnabled(bool enabled);
+
+	bool writeCsv(const std::string& path);
+	bool writeJson(const std::string& path);
+};
+
+/**
+ * Times the enclosing scope and records it into a Profiler series when destroyed, unless the
+ * thread turned recording off. The scope is also recorded as a trace event while the Tracer is
+ * enabled.
+ */
+class ScopedTimer {
+	Profiler::Series* _series;
+	long _cells;
+	double _start;
+
+public:
+	ScopedTimer(Profiler::Series* series, long cells = 0);
+	~ScopedTimer();
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+// Looks the series up once per call site, so a timed scope costs two clock reads and a short lock.
+#define PROFILE_SCOPE_CELLS(name, cells) \
+	static Profiler::Series* PROFILE_CONCAT(_profileSeries, __LINE__) = Profiler::instance().series(name); \
+	ScopedTimer PROFILE_CONCAT(_profileTimer, __LINE__)(PROFILE_CONCAT(_profileSeries, __LINE__), cells)
+
+#define PROFILE_SCOPE(name) PROFILE_SCOPE_CELLS(name, 0)
+
+#endif // PROFILER_HPP
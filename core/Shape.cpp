@@ -0,0 +1,140 @@
+#include "Shape.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+Shape::Shape(Type type) : _type(type) {
+}
+
+/**
+ * @brief Shape::circle
+ * @return a circle centered on the origin
+ */
+Shape Shape::circle(double radius) {
+	Shape s(CIRCLE);
+	s._width = 2 * radius;
+	s._height = 2 * radius;
+	return s;
+}
+
+/**
+ * @brief Shape::rectangle
+ * @return an axis-aligned rectangle centered on the origin
+ */
+Shape Shape::rectangle(double width, double height) {
+	Shape s(RECTANGLE);
+	s._width = width;
+	s._height = height;
+	return s;
+}
+
+/**
+ * @brief Shape::polygon
+ * @param points	vertices relative to the origin, in order; the outline is closed automatically
+ * @return a simple polygon, filled with the even-odd rule
+ */
+Shape Shape::polygon(const std::vector<std::pair<double, double>>& points) {
+	Shape s(POLYGON);
+	s._points = points;
+	return s;
+}
+
+Shape::Type Shape::type() const {
+	return _type;
+}
+
+const std::vector<std::pair<double, double>>& Shape::points() const {
+	return _points;
+}
+
+double Shape::width() const {
+	return _width;
+}
+
+double Shape::height() const {
+	return _height;
+}
+
+/**
+ * @brief Tests a point given relative to the shape's origin, before rotation.
+ */
+bool Shape::contains(double x, double y) const {
+	switch(_type) {
+	case CIRCLE:
+		return x*x + y*y <= _width * _width / 4;
+	case RECTANGLE:
+		return std::fabs(x) <= _width / 2 && std::fabs(y) <= _height / 2;
+	case POLYGON: {
+		bool inside = false;
+		size_t n = _points.size();
+		for(size_t i = 0, j = n - 1;i < n;j = i++) {
+			double xi = _points[i].first, yi = _points[i].second;
+			double xj = _points[j].first, yj = _points[j].second;
+			if((yi > y) != (yj > y) && x < (xj - xi) * (y - yi) / (yj - yi) + xi) {
+				inside = !inside;
+			}
+		}
+		return inside;
+	}
+	}
+	return false;
+}
+
+/**
+ * @brief Shape::radius
+ * @return the distance from the origin to the farthest point of the shape
+ */
+double Shape::radius() const {
+	switch(_type) {
+	case CIRCLE:
+		return _width / 2;
+	case RECTANGLE:
+		return std::sqrt(_width * _width + _height * _height) / 2;
+	case POLYGON: {
+		double r2 = 0;
+		for(auto& p : _points) {
+			r2 = std::max(r2, p.first * p.first + p.second * p.second);
+		}
+		return std::sqrt(r2);
+	}
+	}
+	return 0;
+}
+
+/**
+ * @brief Rasterizes the shape placed at (x, y) and rotated by angle.
+ *
+ * Only the cells within the shape's bounding radius are tested. Parts outside the grid are
+ * clipped.
+ *
+ * @param rows	grid height
+ * @param cols	grid width
+ * @param x		column of the shape's origin
+ * @param y		row of the shape's origin
+ * @param angle	counter-clockwise rotation in radians
+ * @return row-major indices (row * cols + col) of the covered cells, sorted
+ */
+std::vector<int> Shape::cells(int rows, int cols, double x, double y, double angle) const {
+	std::vector<int> cells;
+
+	double r = radius();
+	int r0 = std::max(0, (int)std::floor(y - r));
+	int r1 = std::min(rows - 1, (int)std::ceil(y + r));
+	int c0 = std::max(0, (int)std::floor(x - r));
+	int c1 = std::min(cols - 1, (int)std::ceil(x + r));
+
+	double c = std::cos(angle);
+	double s = std::sin(angle);
+
+	for(int row = r0;row <= r1;row++) {
+		for(int col = c0;col <= c1;col++) {
+			double dx = col - x;
+			double dy = row - y;
+			if(contains(c*dx + s*dy, -s*dx + c*dy)) {
+				cells.push_back(row * cols + col);
+			}
+		}
+	}
+
+	return cells;
+}
@@ -0,0 +1,41 @@
+#ifndef SHAPE_HPP
+#define SHAPE_HPP
+
+#include <utility>
+#include <vector>
+
+/**
+ * A filled 2D outline in lattice units, used to rasterize obstacles onto the grid.
+ *
+ * Coordinates are (x, y) = (column, row); a cell is covered if its center lies inside. Shapes
+ * are defined around their own origin and placed with a position and rotation.
+ */
+class Shape {
+public:
+	enum Type {CIRCLE, RECTANGLE, POLYGON};
+
+private:
+	Type _type;
+	double _width = 0;		// rectangle size, or circle diameter
+	double _height = 0;
+	std::vector<std::pair<double, double>> _points;		// polygon vertices
+
+	Shape(Type type);
+
+public:
+	static Shape circle(double radius);
+	static Shape rectangle(double width, double height);
+	static Shape polygon(const std::vector<std::pair<double, double>>& points);
+
+	Type type() const;
+	const std::vector<std::pair<double, double>>& points() const;
+	double width() const;
+	double height() const;
+
+	bool contains(double x, double y) const;
+	double radius() const;
+
+	std::vector<int> cells(int rows, int cols, double x, double y, double angle = 0) const;
+};
+
+#endif // SHAPE_HPP
@@ -0,0 +1,622 @@
+#include "ShiftedLattice.hpp"
+#include "Lattice.hpp"
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+using namespace lattice;
+
+enum Kind : char {FLUID, NEAR_BARRIER, BARRIER};
+
+#ifdef __F16C__
+
+static inline float fromHalf(std::uint16_t h) {
+	return _cvtsh_ss(h);
+}
+
+static inline std::uint16_t toHalf(float f) {
+	return _cvtss_sh(f, _MM_FROUND_TO_NEAREST_INT);
+}
+
+#else
+
+/**
+ * @brief IEEE half to float, including subnormals (Giesen's branch-light conversion).
+ */
+static inline float fromHalf(std::uint16_t h) {
+	const std::uint32_t shiftedExp = 0x7c00 << 13;
+	std::uint32_t bits = (h & 0x7fff) << 13;
+	std::uint32_t exp = bits & shiftedExp;
+	bits += (127 - 15) << 23;
+	if(exp == shiftedExp) {
+		bits += (128 - 16) << 23;		// inf or NaN
+	} else if(exp == 0) {
+		// Subnormal: renormalize by letting the FPU subtract the implicit one.
+		const std::uint32_t magicBits = 113 << 23;
+		float magic;
+		float value;
+		bits += 1 << 23;
+		std::memcpy(&magic, &magicBits, 4);
+		std::memcpy(&value, &bits, 4);
+		value -= magic;
+		std::memcpy(&bits, &value, 4);
+	}
+	bits |= (std::uint32_t)(h & 0x8000) << 16;
+
+	float f;
+	std::memcpy(&f, &bits, 4);
+	return f;
+}
+
+/**
+ * @brief Float to IEEE half, rounding to nearest even; overflows to infinity.
+ */
+static inline std::uint16_t toHalf(float f) {
+	const std::uint32_t infinity = 255 << 23;
+	const std::uint32_t halfOverflow = (127 + 16) << 23;
+	const std::uint32_t denormMagicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+
+	std::uint32_t bits;
+	std::memcpy(&bits, &f, 4);
+	std::uint32_t sign = bits & 0x80000000u;
+	bits ^= sign;
+
+	std::uint16_t h;
+	if(bits >= halfOverflow) {
+		h = bits > infinity ? 0x7e00 : 0x7c00;
+	} else if(bits < (113u << 23)) {
+		// Result is subnormal or zero: let the FPU round the mantissa into place.
+		float value;
+		float denormMagic;
+		std::memcpy(&value, &bits, 4);
+		std::memcpy(&denormMagic, &denormMagicBits, 4);
+		value += denormMagic;
+		std::memcpy(&bits, &value, 4);
+		h = bits - denormMagicBits;
+	} else {
+		std::uint32_t odd = (bits >> 13) & 1;
+		bits += ((std::uint32_t)(15 - 127) << 23) + 0xfff;
+		bits += odd;
+		h = bits >> 13;
+	}
+	return h | (sign >> 16);
+}
+
+#endif // __F16C__
+
+struct DoubleCodec {
+	typedef double Stored;
+	static double load(double v) { return v; }
+	static double store(double v) { return v; }
+};
+
+struct SingleCodec {
+	typedef float Stored;
+	static double load(float v) { return v; }
+	static float store(double v) { return (float)v; }
+};
+
+struct HalfCodec {
+	typedef std::uint16_t Stored;
+	static double load(std::uint16_t v) { return fromHalf(v); }
+	static std::uint16_t store(double v) { return toHalf((float)v); }
+};
+
+/**
+ * @brief Builds the lattice from a state, e.g. one just loaded.
+ *
+ * The barrier array is shared with the geometry state and must not be edited afterwards.
+ *
+ * @param geometry	state with the barriers, flow parameters and initial populations
+ * @param precision	storage type of the populations
+ */
+ShiftedLattice::ShiftedLattice(const SimState& geometry, Precision precision) :
+	height(geometry.height),
+	width(geometry.width),
+	omega(geometry.omega),
+	u0(geometry.u0),
+	_precision(precision),
+	barrier(geometry.barrier),
+	kind((size_t)geometry.height * geometry.width, FLUID),
+	rho(geometry.fields().density),
+	_ux(geometry.fields().ux),
+	_uy(geometry.fields().uy),
+	_steps(geometry._steps)
+{
+	for(int col = 0;col < width;col++) {
+		for(int row = 0;row < height;row++) {
+			if(barrier[row * width + col]) {
+				kind[(size_t)col * height + row] = BARRIER;
+				continue;
+			}
+			for(int d = 1;d < 9;d++) {
+				int r = (row + dRow[d] + height) % height;
+				int c = (col + dCol[d] + width) % width;
+				if(barrier[r * width + c]) {
+					kind[(size_t)col * height + row] = NEAR_BARRIER;
+				}
+			}
+		}
+	}
+
+	size_t size = (size_t)9 * height * width * storedBytes();
+	if(!populations[0].allocate(size) || !populations[1].allocate(size)) {
+		throw std::bad_alloc();
+	}
+	switch(_precision) {
+	case DOUBLE:
+		store<DoubleCodec>(populations[0].data<double>(), geometry);
+		break;
+	case SINGLE:
+		store<SingleCodec>(populations[0].data<float>(), geometry);
+		break;
+	case HALF:
+		store<HalfCodec>(populations[0].data<std::uint16_t>(), geometry);
+		break;
+	}
+
+	setTileSize(tileRows, tileCols);
+}
+
+/**
+ * @brief Encodes the populations of a state into out.
+ */
+template<typename Codec>
+void ShiftedLattice::store(typename Codec::Stored* out, const SimState& geometry) {
+	const arma::mat* n[9];
+	geometry.populations(n);
+	const size_t cells = (size_t)height * width;
+
+	for(int d = 0;d < 9;d++) {
+		const double* p = n[d]->memptr();
+		for(size_t i = 0;i < cells;i++) {
+			out[d * cells + i] = Codec::store(p[i] - weight[d]);
+		}
+	}
+}
+
+/**
+ * @brief Decodes the populations in `in` into a state.
+ */
+template<typename Codec>
+void ShiftedLattice::load(const typename Codec::Stored* in, SimState& s) {
+	arma::mat* n[9] = {&s.n0, &s.nN, &s.nS, &s.nE, &s.nW, &s.nNE, &s.nSE, &s.nNW, &s.nSW};
+	const size_t cells = (size_t)height * width;
+
+	for(int d = 0;d < 9;d++) {
+		double* p = n[d]->memptr();
+		for(size_t i = 0;i < cells;i++) {
+			p[i] = Codec::load(in[d * cells + i]) + weight[d];
+		}
+	}
+}
+
+/**
+ * @brief Streams and collides every cell in one pass.
+ */
+void ShiftedLattice::step() {
+	PROFILE_SCOPE_CELLS("step", (long)height * width);
+
+	int next = 1 - current;
+	switch(_precision) {
+	case DOUBLE:
+		stepWith<DoubleCodec>(populations[current].data<double>(), populations[next].data<double>());
+		break;
+	case SINGLE:
+		stepWith<SingleCodec>(populations[current].data<float>(), populations[next].data<float>());
+		break;
+	case HALF:
+		stepWith<HalfCodec>(populations[current].data<std::uint16_t>(),
+							populations[next].data<std::uint16_t>());
+		break;
+	}
+	current = next;
+	_steps++;
+}
+
+/**
+ * @brief Runs one step over every tile that holds fluid, on the pool if there is one.
+ */
+template<typename Codec>
+void ShiftedLattice::stepWith(const typename Codec::Stored* in, typename Codec::Stored* out) {
+	// What SimState::forceInflow() writes over the post-collision populations of column 0.
+	typename Codec::Stored inflow[9];
+	for(int d = 0;d < 9;d++) {
+		double cu = dCol[d] * u0;
+		inflow[d] = Codec::store(weight[d] * (1 - 1.5*u0*u0 + 3*cu + 4.5*cu*cu) - weight[d]);
+	}
+
+	// Tiles are sorted boundary first, so the slow ones start early and fluid tiles fill in.
+	for(const Tile& tile : tiles) {
+		if(tile.kind == SOLID_TILE) {
+			break;
+		}
+		auto task = [this, in, out, &tile, &inflow] {
+			if(tile.kind == FLUID_TILE) {
+				stepTile<Codec, false>(in, out, tile, inflow);
+			} else {
+				stepTile<Codec, true>(in, out, tile, inflow);
+			}
+		};
+		if(pool) {
+			pool->submit(owner(tile.col), task);
+		} else {
+			task();
+		}
+	}
+	if(pool) {
+		pool->wait();
+	}
+}
+
+/**
+ * @brief BGK collision of one cell in place; also returns its density and velocity.
+ */
+static inline void relax(double* f, double omega, double& density, double& vx, double& vy) {
+	density = f[D0] + f[DN] + f[DS] + f[DE] + f[DW] + f[DNE] + f[DSE] + f[DNW] + f[DSW];
+	vx = (f[DE] + f[DNE] + f[DSE] - f[DW] - f[DNW] - f[DSW]) / density;
+	vy = (f[DN] + f[DNE] + f[DNW] - f[DS] - f[DSE] - f[DSW]) / density;
+
+	double omu215 = 1 - 1.5*(vx*vx + vy*vy);
+	for(int d = 0;d < 9;d++) {
+		double cu = dCol[d]*vx + dRow[d]*vy;
+		double eq = weight[d] * density * (omu215 + 3*cu + 4.5*cu*cu);
+		f[d] = (1 - omega) * f[d] + omega * eq;
+	}
+}
+
+/**
+ * @brief Pulls the post-collision populations in `in` to each cell of a tile, collides them and
+ * writes the result to out.
+ *
+ * With boundary false the tile and its neighbours must be all fluid, so no cell is checked and,
+ * away from the first and last row where the neighbours wrap around, every neighbour is at a
+ * fixed offset and that loop has no branches. GCC still does not vectorize it, because of the
+ * conversions between the stored precision and double; the gain is the checks it skips.
+ */
+template<typename Codec, bool boundary>
+void ShiftedLattice::stepTile(const typename Codec::Stored* __restrict__ in,
+							  typename Codec::Stored* __restrict__ out, const Tile& tile,
+							  const typename Codec::Stored* inflow) {
+	typedef typename Codec::Stored Stored;
+	const size_t cells = (size_t)height * width;
+	const double omega = this->omega;
+
+	for(int col = tile.col;col < tile.col + tile.cols;col++) {
+		const size_t here = (size_t)col * height;
+		const size_t west = (size_t)((col + width - 1) % width) * height;
+		const size_t east = (size_t)((col + 1) % width) * height;
+		const char* kindCol = &kind[here];
+
+		double* __restrict__ outRho = rho.colptr(col);
+		double* __restrict__ outUx  = _ux.colptr(col);
+		double* __restrict__ outUy  = _uy.colptr(col);
+
+		int inner = tile.row;
+		int innerEnd = tile.row;
+		if(!boundary) {
+			inner = std::max(tile.row, 1);
+			innerEnd = std::max(inner, std::min(tile.row + tile.rows, height - 1));
+
+			const Stored* __restrict__ from0  = in + D0  * cells + here;
+			const Stored* __restrict__ fromN  = in + DN  * cells + here - 1;
+			const Stored* __restrict__ fromS  = in + DS  * cells + here + 1;
+			const Stored* __restrict__ fromE  = in + DE  * cells + west;
+			const Stored* __restrict__ fromW  = in + DW  * cells + east;
+			const Stored* __restrict__ fromNE = in + DNE * cells + west - 1;
+			const Stored* __restrict__ fromSE = in + DSE * cells + west + 1;
+			const Stored* __restrict__ fromNW = in + DNW * cells + east - 1;
+			const Stored* __restrict__ fromSW = in + DSW * cells + east + 1;
+			Stored* __restrict__ to0  = out + D0  * cells + here;
+			Stored* __restrict__ toN  = out + DN  * cells + here;
+			Stored* __restrict__ toS  = out + DS  * cells + here;
+			Stored* __restrict__ toE  = out + DE  * cells + here;
+			Stored* __restrict__ toW  = out + DW  * cells + here;
+			Stored* __restrict__ toNE = out + DNE * cells + here;
+			Stored* __restrict__ toSE = out + DSE * cells + here;
+			Stored* __restrict__ toNW = out + DNW * cells + here;
+			Stored* __restrict__ toSW = out + DSW * cells + here;
+
+			for(int row = inner;row < innerEnd;row++) {
+				double f[9];
+				f[D0]  = Codec::load(from0[row])  + weight[D0];
+				f[DN]  = Codec::load(fromN[row])  + weight[DN];
+				f[DS]  = Codec::load(fromS[row])  + weight[DS];
+				f[DE]  = Codec::load(fromE[row])  + weight[DE];
+				f[DW]  = Codec::load(fromW[row])  + weight[DW];
+				f[DNE] = Codec::load(fromNE[row]) + weight[DNE];
+				f[DSE] = Codec::load(fromSE[row]) + weight[DSE];
+				f[DNW] = Codec::load(fromNW[row]) + weight[DNW];
+				f[DSW] = Codec::load(fromSW[row]) + weight[DSW];
+
+				relax(f, omega, outRho[row], outUx[row], outUy[row]);
+
+				to0[row]  = Codec::store(f[D0]  - weight[D0]);
+				toN[row]  = Codec::store(f[DN]  - weight[DN]);
+				toS[row]  = Codec::store(f[DS]  - weight[DS]);
+				toE[row]  = Codec::store(f[DE]  - weight[DE]);
+				toW[row]  = Codec::store(f[DW]  - weight[DW]);
+				toNE[row] = Codec::store(f[DNE] - weight[DNE]);
+				toSE[row] = Codec::store(f[DSE] - weight[DSE]);
+				toNW[row] = Codec::store(f[DNW] - weight[DNW]);
+				toSW[row] = Codec::store(f[DSW] - weight[DSW]);
+			}
+		}
+
+		for(int row = tile.row;row < tile.row + tile.rows;row++) {
+			if(row == inner && innerEnd > inner) {
+				row = innerEnd - 1;
+				continue;
+			}
+			if(boundary && kindCol[row] == BARRIER) {
+				continue;
+			}
+			const size_t north = row + 1 == height ? 0 : row + 1;
+			const size_t south = row == 0 ? height - 1 : row - 1;
+
+			// Pull what every neighbour sent here; from a barrier, what this cell sent it.
+			double f[9];
+			for(int d = 0;d < 9;d++) {
+				size_t c = dCol[d] > 0 ? west : dCol[d] < 0 ? east : here;
+				size_t r = dRow[d] > 0 ? south : dRow[d] < 0 ? north : row;
+				f[d] = weight[d] + (boundary && kind[c + r] == BARRIER
+									? Codec::load(in[opposite[d] * cells + here + row])
+									: Codec::load(in[d * cells + c + r]));
+			}
+
+			relax(f, omega, outRho[row], outUx[row], outUy[row]);
+
+			for(int d = 0;d < 9;d++) {
+				out[d * cells + here + row] = Codec::store(f[d] - weight[d]);
+			}
+		}
+
+		if(col == 0) {
+			for(int row = tile.row;row < tile.row + tile.rows;row++) {
+				for(int d : {DE, DW, DNE, DSE, DNW, DSW}) {
+					out[d * cells + row] = inflow[d];
+				}
+			}
+		}
+	}
+}
+
+/**
+ * @brief Cuts the lattice into tiles and sorts them by how much work they are.
+ *
+ * A tile is solid if all its cells are barriers, fluid if no cell in it or next to it is one,
+ * and a boundary tile otherwise.
+ */
+void ShiftedLattice::classifyTiles() {
+	tiles.clear();
+	for(int col = 0;col < width;col += tileCols) {
+		for(int row = 0;row < height;row += tileRows) {
+			Tile tile;
+			tile.row = row;
+			tile.col = col;
+			tile.rows = std::min(tileRows, height - row);
+			tile.cols = std::min(tileCols, width - col);
+
+			int counts[3] = {0, 0, 0};
+			for(int c = col;c < col + tile.cols;c++) {
+				for(int r = row;r < row + tile.rows;r++) {
+					counts[(int)kind[(size_t)c * height + r]]++;
+				}
+			}
+			tile.kind = counts[BARRIER] == tile.rows * tile.cols ? SOLID_TILE
+					  : counts[FLUID] == tile.rows * tile.cols ? FLUID_TILE : BOUNDARY_TILE;
+			tiles.push_back(tile);
+		}
+	}
+
+	std::stable_sort(tiles.begin(), tiles.end(), [](const Tile& a, const Tile& b) {
+		return a.kind < b.kind;
+	});
+}
+
+/**
+ * @brief Sets the tile size, in cells (64 x 64 by default). Smaller tiles balance better and
+ * skip more of a large barrier; larger ones have less overhead per tile.
+ */
+void ShiftedLattice::setTileSize(int rows, int cols) {
+	tileRows = std::max(1, std::min(rows, height));
+	tileCols = std::max(1, std::min(cols, width));
+	classifyTiles();
+	if(pool) {
+		place();
+	}
+}
+
+/**
+ * @brief Sets how many threads step the tiles and places the lattice in their memory.
+ * @param threads	1 to step on the calling thread, 0 for one per hardware thread
+ * @param pin		pin each worker to its own CPU, see ThreadPool
+ */
+void ShiftedLattice::setThreads(int threads, bool pin) {
+	pool.reset();
+	if(threads != 1) {
+		pool.reset(new ThreadPool(threads, pin));
+	}
+	place();
+}
+
+/**
+ * @brief Backs the populations and fields with transparent huge pages (off by default), which
+ * saves TLB misses on lattices of hundreds of megabytes.
+ */
+void ShiftedLattice::setHugePages(bool enabled) {
+	hugePages = enabled;
+	place();
+}
+
+/**
+ * @brief The worker that owns a column: tile columns are dealt out in contiguous slabs.
+ */
+int ShiftedLattice::owner(int col) {
+	int workers = threads();
+	int tileColumns = (width + tileCols - 1) / tileCols;
+	return (long)(col / tileCols) * workers / tileColumns;
+}
+
+/**
+ * @brief Moves the populations and fields to fresh memory, each slab of columns first written
+ * by the worker that owns it, so the kernel puts its pages on that worker's NUMA node. Keeps
+ * the old memory if the new one cannot be mapped.
+ */
+void ShiftedLattice::place() {
+	PROFILE_SCOPE("place");
+
+	const size_t cells = (size_t)height * width;
+	const size_t value = storedBytes();
+	PageBuffer placed[2];
+	for(int i = 0;i < 2;i++) {
+		if(!placed[i].allocate(9 * cells * value, hugePages)) {
+			return;
+		}
+	}
+	arma::mat* fields[3] = {&rho, &_ux, &_uy};
+	arma::mat fresh[3];
+	for(int k = 0;k < 3;k++) {
+		fresh[k].set_size(height, width);		// left uninitialized
+		if(hugePages) {
+			PageBuffer::adviseHugePages(fresh[k].memptr(), cells * sizeof(double));
+		}
+	}
+
+	auto copy = [&](int worker) {
+		for(int col = 0;col < width;col++) {
+			if(owner(col) != worker) {
+				continue;
+			}
+			size_t offset = (size_t)col * height;
+			for(int i = 0;i < 2;i++) {
+				const char* from = populations[i].data<char>();
+				char* to = placed[i].data<char>();
+				for(int d = 0;d < 9;d++) {
+					std::memcpy(to + (d * cells + offset) * value, from + (d * cells + offset) * value,
+								height * value);
+				}
+			}
+			for(int k = 0;k < 3;k++) {
+				std::memcpy(fresh[k].colptr(col), fields[k]->colptr(col), height * sizeof(double));
+			}
+		}
+	};
+	if(pool) {
+		pool->runOnEach(copy);
+	} else {
+		copy(0);
+	}
+
+	for(int i = 0;i < 2;i++) {
+		populations[i] = std::move(placed[i]);
+	}
+	for(int k = 0;k < 3;k++) {
+		fields[k]->steal_mem(fresh[k]);
+	}
+}
+
+int ShiftedLattice::threads() {
+	return pool ? pool->size() : 1;
+}
+
+/**
+ * @brief Counts the tiles of each kind.
+ * @param solid		tiles that are skipped
+ * @param fluid		tiles stepped without barrier checks
+ * @param boundary	tiles stepped with them
+ */
+void ShiftedLattice::tileCounts(int& solid, int& fluid, int& boundary) {
+	solid = fluid = boundary = 0;
+	for(const Tile& tile : tiles) {
+		(tile.kind == SOLID_TILE ? solid : tile.kind == FLUID_TILE ? fluid : boundary)++;
+	}
+}
+
+int ShiftedLattice::steps() {
+	return _steps;
+}
+
+ShiftedLattice::Precision ShiftedLattice::precision() {
+	return _precision;
+}
+
+/**
+ * @brief Memory per cell: both population buffers plus the density and velocity fields.
+ */
+int ShiftedLattice::bytesPerCell() {
+	return 2 * 9 * storedBytes() + 3 * sizeof(double);
+}
+
+/**
+ * @brief Size of one stored population.
+ */
+std::size_t ShiftedLattice::storedBytes() {
+	return _precision == DOUBLE ? sizeof(double) : _precision == SINGLE ? sizeof(float)
+																		: sizeof(std::uint16_t);
+}
+
+const arma::mat& ShiftedLattice::ux() {
+	return _ux;
+}
+
+const arma::mat& ShiftedLattice::uy() {
+	return _uy;
+}
+
+const arma::mat& ShiftedLattice::density() {
+	return rho;
+}
+
+/**
+ * @brief The current fields, as SimState::getFrame() would give them.
+ */
+Frame ShiftedLattice::getFrame() {
+	PROFILE_SCOPE("frame");
+	return Frame(height, width, barrier, _ux, _uy, rho);
+}
+
+/**
+ * @brief A SimState with BGK collision that continues this run, e.g. to save it. Populations
+ * are decoded to double, so it carries on at full precision.
+ */
+SimState ShiftedLattice::state() {
+	SimState s(height, width, 0.0, u0);
+	s.omega = omega;
+	s.barrier = barrier;
+	s._solidCells.clear();
+	for(int i = 0;i < height * width;i++) {
+		if(barrier[i]) {
+			s._solidCells.push_back(i);
+		}
+	}
+	s.started = _steps > 0;
+	s._steps = _steps;
+	s.setCollisionModel(SimState::BGK);
+
+	switch(_precision) {
+	case DOUBLE:
+		load<DoubleCodec>(populations[current].data<double>(), s);
+		break;
+	case SINGLE:
+		load<SingleCodec>(populations[current].data<float>(), s);
+		break;
+	case HALF:
+		load<HalfCodec>(populations[current].data<std::uint16_t>(), s);
+		break;
+	}
+
+	FrameFields& fields = s.writeFields(false);
+	fields.density = rho;
+	fields.ux = _ux;
+	fields.uy = _uy;
+	s.frames.clear();
+	s.pushFrame(Frame(height, width, barrier, s._fields));
+	return s;
+}
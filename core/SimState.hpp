@@ -0,0 +1,274 @@
+#ifndef SIMSTATE_HPP
+#define SIMSTATE_HPP
+
+#include "DataStream.hpp"
+#include "Frame.hpp"
+#include "FrameRing.hpp"
+#include "Obstacle.hpp"
+
+#include <armadillo>
+
+#include <boost/circular_buffer.hpp>
+#include <boost/shared_array.hpp>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+class SimState
+{
+	friend class Ensemble;
+	friend class MultiBlock;
+	friend class MomentLattice;
+	friend class ShiftedLattice;
+	friend class Tuner;
+
+	// Set once the simulation has been started (when step() is first called).
+	bool started = false;
+
+	int height;						// lattice dimensions
+	int width;
+	//double viscosity;				// fluid viscosity
+	double omega;					// "relaxation" parameter
+	double u0;						// initial and in-flow speed
+
+	boost::shared_array<bool> barrier;
+	std::vector<int> _solidCells;	// row-major indices of barrier cells, sorted
+	bool _barrierPublished = false;	// a frame or snapshot of the running state shares barrier
+
+	// Moving obstacles. Their footprint is kept apart from the static barriers: a sorted list of
+	// covered cells (never static barrier cells) that frames share, plus the wall velocity of
+	// each of those cells for the current step.
+	std::vector<Obstacle> _obstacles;
+	std::shared_ptr<const std::vector<int>> _movingCells;
+	std::vector<std::pair<double, double>> _wallVelocity;
+
+	// abbreviations for lattice-Boltzmann weight factors
+	constexpr static double four9ths = 4.0/9.0;
+	constexpr static double one9th   = 1.0/9.0;
+	constexpr static double one36th  = 1.0/36.0;
+
+	arma::mat n0;
+	arma::mat nN;
+	arma::mat nS;
+	arma::mat nE;
+	arma::mat nW;
+	arma::mat nNE;
+	arma::mat nSE;
+	arma::mat nNW;
+	arma::mat nSW;
+	// Macroscopic density and velocity, shared with the frames taken since they were computed;
+	// see writeFields(). Steps that need no fields leave them behind the populations until
+	// fields() is called.
+	mutable std::shared_ptr<FrameFields> _fields;
+	mutable bool _fieldsCurrent = true;
+	std::vector<double> _inletFields;	// density, ux, uy of column 0 before forceInflow()
+	bool _inletSaved = false;
+	arma::mat _rolled;	// scratch matrix stream() rolls the populations through
+
+public:
+	/**
+	 * The nine populations, in the order rest, N, S, E, W, NE, SE, NW, SW.
+	 */
+	struct Populations {
+		arma::mat n0, nN, nS, nE, nW, nNE, nSE, nNW, nSW;
+	};
+
+private:
+	// Populations handed to the last snapshot instead of being copied; the live matrices are
+	// empty meanwhile. The next stream() reads straight out of them and anything else that
+	// changes populations first copies them back, see reclaim(). The fields are current while
+	// populations are lent.
+	std::shared_ptr<const Populations> _lent;
+
+	void populations(const arma::mat* n[9]) const;
+	void reclaim();
+	void stream();
+	void collide(bool output);
+	template<bool Fields> void collideTRT();
+	template<bool Fields> void collideMRT();
+	template<bool Fields> void collideRegularized();
+	void forceInflow();
+	void applyInlet();
+	void applyOutlet();
+	void updateBoundaryRows();
+
+	void sampleResidual();
+	void detachBarrier();
+	void reinitializeCell(int row, int col);
+	void updateObstacles();
+	void setEquilibrium(int row, int col, double density, double ux, double uy);
+	FrameFields& writeFields(bool keep);
+	const FrameFields& fields() const;
+	void computeFields() const;
+
+	boost::circular_buffer<Frame> frames;	// with a frame limit, exactly that many slots, reused
+	void pushFrame(Frame&& frame);
+	int _firstFrame = 0;			// index of frames.front() once old frames are dropped
+	int _frameLimit = 0;			// max frames kept, 0 keeps every frame
+	int _capturedStep = 0;			// step of frames.back()
+
+	int _steps = 0;					// number of times step() has been called
+
+    std::shared_ptr<SimState> _initialState = nullptr;
+
+	// Shared-memory ring the fields are published to every _ringInterval steps, if set.
+	std::shared_ptr<FrameRing> _ring;
+	int _ringInterval = 1;
+	void publishRing();
+
+public:
+	/**
+	 * Collision operator. All of them give the same viscosity for the same omega.
+	 *
+	 * BGK			single relaxation time; goes unstable as the viscosity approaches zero
+	 * TRT			two relaxation times; walls stay halfway between cells at any viscosity,
+	 *				which helps accuracy on coarse grids, but it is no more stable than BGK
+	 * MRT			multiple relaxation times (Lallemand and Luo, 2000); the most stable, use it
+	 *				to reach high Reynolds numbers
+	 * REGULARIZED	BGK with the non-equilibrium part rebuilt from the stress; far more stable
+	 *				than BGK in open shear flow, less so right after a start next to obstacles
+	 */
+	enum CollisionModel {BGK, TRT, MRT, REGULARIZED};
+
+	/**
+	 * Boundary on column 0. FORCED_EQUILIBRIUM overwrites the eastward populations with the
+	 * equilibrium at u0 after every collision, whatever the flow does, and lets the westward ones
+	 * wrap around to the last column. VELOCITY and PRESSURE are Zou-He boundaries: the unknown
+	 * eastward populations are set so the cell has velocity (u0, 0) or the given density, and
+	 * nothing wraps around. A pressure inlet only drives the flow if its density is above the
+	 * density at the outlet (about 1), since the pressure drop is what pushes the fluid.
+	 */
+	enum Inlet {FORCED_EQUILIBRIUM, VELOCITY, PRESSURE};
+
+	/**
+	 * Boundary on the last column. PERIODIC wraps outflow around to column 0, so with a forced
+	 * inlet wakes come back in upstream. ZERO_GRADIENT copies the unknown westward populations from
+	 * the column before; CONVECTIVE advects them out at the local normal velocity, which reflects
+	 * less of a passing vortex. Neither open outlet conserves mass exactly; with a velocity inlet
+	 * the mean density drifts by a few percent over a long run.
+	 */
+	enum Outlet {PERIODIC, ZERO_GRADIENT, CONVECTIVE};
+
+	/**
+	 * Norm used to measure how much the velocity field changed between two residual samples.
+	 */
+	enum ResidualNorm {L2, LINF};
+
+	struct Residual {
+		int step;
+		double value;
+	};
+
+	/**
+	 * When step() takes a frame. Steps that take none skip writing the macroscopic fields unless
+	 * that step needs them anyway (the ring, a residual sample, moving obstacles or a convective
+	 * outlet), so fast-forwarding costs little more than streaming and collision.
+	 *
+	 * EVERY_N			every interval steps; with an interval of 1 (the default) every step
+	 * ON_DEMAND		only when captureFrame() is called
+	 * ON_CONVERGENCE	at the step a residual sample first finds the run converged, see
+	 *					setConvergence()
+	 */
+	enum CapturePolicy {EVERY_N, ON_DEMAND, ON_CONVERGENCE};
+
+private:
+	CollisionModel _collision = BGK;
+	CapturePolicy _capture = EVERY_N;
+	int _captureInterval = 1;
+
+	// Open boundaries, applied to the rows of column 0 and width - 1 that are not barriers. The
+	// row lists are rebuilt after barriers change.
+	Inlet _inlet = FORCED_EQUILIBRIUM;
+	Outlet _outlet = PERIODIC;
+	double _inletDensity = 1;
+	std::vector<int> _inletRows;
+	std::vector<int> _outletRows;
+	bool _boundaryRowsDirty = true;
+	std::vector<double> _outletPrevious;	// W, NW, SW populations of each outlet row last step
+
+	// Steady-state detection. Every _convergenceInterval steps the change of velocity since the
+	// previous sample is measured; the run is converged once it drops below _tolerance.
+	int _convergenceInterval = 0;	// 0 disables the check
+	double _tolerance = 1e-6;
+	ResidualNorm _norm = LINF;
+	bool _converged = false;
+	std::shared_ptr<const FrameFields> _sample;	// fields at the previous sample
+	std::vector<Residual> _residuals;
+
+public:
+    SimState(int height, int width, double viscosity = 0.02, double u0 = 0.05);
+	SimState(const SimState& geometry, double viscosity, double u0);
+
+	void step();
+	int steps();
+
+    Frame getFrame(int i = -1);
+    int numFrames();
+	void setFrameLimit(int limit);
+	void setFrameRing(const std::shared_ptr<FrameRing>& ring, int interval = 1);
+
+	void setCapturePolicy(CapturePolicy policy, int interval = 1);
+	CapturePolicy capturePolicy();
+	void captureFrame();
+
+	void setCollisionModel(CollisionModel model);
+	CollisionModel collisionModel();
+
+	void setBoundaries(Inlet inlet, Outlet outlet, double inletDensity = 1);
+	Inlet inlet();
+	Outlet outlet();
+	double inletDensity();
+
+	void setConvergence(int interval, double tolerance, ResidualNorm norm = LINF);
+	bool converged();
+	const std::vector<Residual>& residuals();
+
+	bool getBarrier(int row, int col);
+	void setBarrier(bool val, int row, int col);
+	void setBarriers(const std::vector<int>& cells, bool val);
+	void toggleBarrier(int row, int col);
+	bool isSolid(int row, int col);
+
+	void addObstacle(const Obstacle& obstacle);
+	void clearObstacles();
+	const std::vector<Obstacle>& obstacles();
+
+	const arma::mat& ux();
+	const arma::mat& uy();
+	const arma::mat& density();
+
+    SimState initialState();
+
+	/**
+	 * Copy of everything save() writes, see snapshot().
+	 */
+	struct Snapshot {
+		bool started;
+		int height;
+		int width;
+		double omega;
+		double u0;
+		int steps;
+		CollisionModel collision;
+		Inlet inlet;
+		Outlet outlet;
+		double inletDensity;
+		boost::shared_array<const bool> barrier;
+		std::vector<Obstacle> obstacles;
+		std::shared_ptr<const Populations> populations;
+		std::shared_ptr<const FrameFields> fields;
+		std::vector<double> outletPrevious;
+	};
+
+	static const std::uint32_t FILE_MAGIC;
+	static const std::int32_t FILE_VERSION;
+
+	Snapshot snapshot();
+
+	static SimState load(DataStream& stream);
+	void save(DataStream& stream);
+	static void save(const Snapshot& snapshot, DataStream& stream);
+};
+
+#endif // SIMSTATE_HPP
@@ -0,0 +1,260 @@
+#include "Sweep.hpp"
+#include "Ensemble.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "Tracer.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+// Largest domain (in cells) that is batched into ensembles by default.
+static constexpr int ENSEMBLE_MAX_CELLS = 200 * 200;
+static constexpr int ENSEMBLE_LANES = 8;
+
+Sweep::Sweep(const SimState& geometry) : _geometry(geometry) {
+}
+
+/**
+ * @brief Sets the maximum number of steps per case.
+ */
+void Sweep::setSteps(int maxSteps) {
+	_maxSteps = maxSteps;
+}
+
+/**
+ * @brief Stops each case early once it reaches steady state. See SimState::setConvergence().
+ */
+void Sweep::setConvergence(int interval, double tolerance, SimState::ResidualNorm norm) {
+	_convergenceInterval = interval;
+	_tolerance = tolerance;
+	_norm = norm;
+}
+
+/**
+ * @brief Sets the directory that receives one .istate file per case and a summary sweep.csv.
+ *
+ * Nothing is written if this is empty.
+ */
+void Sweep::setOutputDir(const std::string& dir) {
+	_outputDir = dir;
+}
+
+/**
+ * @brief Sets the number of worker threads, 0 for one per hardware thread.
+ */
+void Sweep::setThreads(int threads) {
+	_threads = threads;
+}
+
+/**
+ * @brief Sets how many cases are stepped together in one Ensemble.
+ *
+ * 0 picks automatically: batches of 8 on domains up to 200x200, single cases otherwise. Batches
+ * always run the full step count and only have BGK and the forced periodic boundaries, so
+ * convergence checking, another collision model or open boundaries on the geometry force single
+ * cases.
+ */
+void Sweep::setLanes(int lanes) {
+	_lanes = lanes;
+}
+
+/**
+ * @brief Sweep::lanes
+ * @return the number of cases per task for the current settings
+ */
+int Sweep::lanes() {
+	// Ensembles have neither per-member convergence checks, moving obstacles, collision
+	// operators other than BGK nor open boundaries.
+	if(_convergenceInterval > 0 || !_geometry.obstacles().empty()
+			|| _geometry.collisionModel() != SimState::BGK
+			|| _geometry.inlet() != SimState::FORCED_EQUILIBRIUM || _geometry.outlet() != SimState::PERIODIC) {
+		return 1;
+	}
+	if(_lanes > 0) {
+		return _lanes;
+	}
+
+	int cells = _geometry.ux().n_rows * _geometry.ux().n_cols;
+	return cells <= ENSEMBLE_MAX_CELLS ? ENSEMBLE_LANES : 1;
+}
+
+/**
+ * @brief Builds every combination of the given viscosities and in-flow speeds.
+ */
+std::vector<Sweep::Case> Sweep::grid(const std::vector<double>& viscosities, const std::vector<double>& u0s) {
+	std::vector<Case> cases;
+	for(double viscosity : viscosities) {
+		for(double u0 : u0s) {
+			cases.push_back({viscosity, u0});
+		}
+	}
+	return cases;
+}
+
+/**
+ * @brief Simulates a single case to completion and saves its final state.
+ */
+Sweep::Result Sweep::runCase(int index, const Case& c) {
+	TRACE_SCOPE("sweepCase");
+
+	auto start = std::chrono::steady_clock::now();
+
+	SimState state(_geometry, c.viscosity, c.u0);
+	state.setFrameLimit(1);
+	state.setCapturePolicy(SimState::EVERY_N, _maxSteps);
+	if(_convergenceInterval > 0) {
+		state.setConvergence(_convergenceInterval, _tolerance, _norm);
+	}
+
+	while(state.steps() < _maxSteps && !state.converged()) {
+		state.step();
+	}
+
+	return finish(index, c, state, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+}
+
+/**
+ * @brief Simulates consecutive cases together in one Ensemble.
+ * @param first	index of cases.front() in the sweep
+ */
+std::vector<Sweep::Result> Sweep::runBatch(int first, const std::vector<Case>& cases) {
+	TRACE_SCOPE("sweepBatch");
+
+	auto start = std::chrono::steady_clock::now();
+
+	std::vector<double> viscosities;
+	std::vector<double> u0s;
+	for(auto& c : cases) {
+		viscosities.push_back(c.viscosity);
+		u0s.push_back(c.u0);
+	}
+
+	Ensemble ensemble(_geometry, viscosities, u0s);
+	while(ensemble.steps() < _maxSteps) {
+		ensemble.step();
+	}
+
+	// The batch's time is split evenly over its members.
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / cases.size();
+
+	std::vector<Result> results;
+	for(size_t m = 0;m < cases.size();m++) {
+		SimState state = ensemble.state(m);
+		results.push_back(finish(first + m, cases[m], state, seconds));
+	}
+	return results;
+}
+
+/**
+ * @brief Collects the result of a finished case and saves its final state.
+ */
+Sweep::Result Sweep::finish(int index, const Case& c, SimState& state, double seconds) {
+	Result result;
+	result.params = c;
+	result.steps = state.steps();
+	result.converged = state.converged();
+	result.residual = state.residuals().empty() ? 0 : state.residuals().back().value;
+
+	if(!_outputDir.empty()) {
+		std::ostringstream name;
+		name << _outputDir << "/case_" << index << ".istate";
+		result.file = name.str();
+
+		std::ofstream file(result.file, std::ios::binary);
+		DataStream stream(file);
+		state.save(stream);
+		file.close();
+		if(!stream.ok() || !file) {
+			result.file.clear();
+		}
+	}
+
+	result.seconds = seconds;
+	return result;
+}
+
+/**
+ * @brief Runs every case and blocks until all of them are done.
+ *
+ * If an output directory is set, each case's row is appended to sweep.csv as soon as the case
+ * finishes, so partial results survive an interrupted sweep.
+ *
+ * @return one result per case, in the order of cases
+ */
+std::vector<Sweep::Result> Sweep::run(const std::vector<Case>& cases) {
+	std::vector<Result> results(cases.size());
+	std::mutex summaryMutex;
+	std::ofstream summary;
+
+	if(!_outputDir.empty()) {
+		summary.open(_outputDir + "/sweep.csv");
+		summary << "case,viscosity,u0,steps,converged,residual,seconds,file\n";
+	}
+
+	auto report = [&](size_t i, const Result& r) {
+		results[i] = r;
+
+		std::lock_guard<std::mutex> lock(summaryMutex);
+		if(summary.is_open()) {
+			summary << i << "," << r.params.viscosity << "," << r.params.u0 << "," << r.steps << ","
+					<< r.converged << "," << r.residual << "," << r.seconds << "," << r.file << std::endl;
+		}
+	};
+
+	int batch = lanes();
+
+	// Each case times itself. Profiling the workers would make them wait on each other for the
+	// shared series on every step, and mix all cases into one "step" series.
+	auto start = std::chrono::steady_clock::now();
+	{
+		ThreadPool pool(_threads);
+		for(size_t i = 0;i < cases.size();i += batch) {
+			if(batch == 1) {
+				pool.submit([this, i, &cases, &report] {
+					Profiler::setThreadEnabled(false);
+					report(i, runCase(i, cases[i]));
+				});
+			} else {
+				size_t end = std::min(cases.size(), i + batch);
+				pool.submit([this, i, end, &cases, &report] {
+					Profiler::setThreadEnabled(false);
+					std::vector<Case> members(cases.begin() + i, cases.begin() + end);
+					auto batchResults = runBatch(i, members);
+					for(size_t m = 0;m < batchResults.size();m++) {
+						report(i + m, batchResults[m]);
+					}
+				});
+			}
+		}
+		pool.wait();
+	}
+	_wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	_cellUpdates = 0;
+	int height = _geometry.ux().n_rows;
+	int width = _geometry.ux().n_cols;
+	for(auto& r : results) {
+		_cellUpdates += (double)r.steps * height * width;
+	}
+
+	return results;
+}
+
+/**
+ * @brief Sweep::seconds
+ * @return wall-clock time of the last run()
+ */
+double Sweep::seconds() {
+	return _wallSeconds;
+}
+
+/**
+ * @brief Sweep::mlups
+ * @return million lattice updates per second over all cases of the last run()
+ */
+double Sweep::mlups() {
+	return _wallSeconds > 0 ? _cellUpdates / _wallSeconds / 1e6 : 0;
+}
@@ -0,0 +1,69 @@
+#ifndef SWEEP_HPP
+#define SWEEP_HPP
+
+#include "SimState.hpp"
+
+#include <string>
+#include <vector>
+
+/**
+ * Runs one geometry with many (viscosity, u0) pairs in parallel.
+ *
+ * Every case shares the barrier array of the geometry state. Cases are scheduled on a
+ * work-stealing ThreadPool; each one writes its final state as soon as it finishes. On small
+ * domains without convergence checks, cases are batched into Ensembles so each task fills the
+ * SIMD lanes.
+ */
+class Sweep {
+public:
+	struct Case {
+		double viscosity;
+		double u0;
+	};
+
+	struct Result {
+		Case params;
+		int steps;
+		bool converged;
+		double residual;	// last sampled residual, 0 if convergence was not checked
+		double seconds;
+		std::string file;	// where the final state was written, empty if not saved
+	};
+
+private:
+	SimState _geometry;
+	int _maxSteps = 10000;
+	int _convergenceInterval = 0;
+	double _tolerance = 1e-6;
+	SimState::ResidualNorm _norm = SimState::LINF;
+	std::string _outputDir;
+	int _threads = 0;
+	int _lanes = 0;
+
+	// throughput of the last run()
+	double _wallSeconds = 0;
+	double _cellUpdates = 0;
+
+	Result runCase(int index, const Case& c);
+	std::vector<Result> runBatch(int first, const std::vector<Case>& cases);
+	Result finish(int index, const Case& c, SimState& state, double seconds);
+	int lanes();
+
+public:
+	explicit Sweep(const SimState& geometry);
+
+	void setSteps(int maxSteps);
+	void setConvergence(int interval, double tolerance, SimState::ResidualNorm norm = SimState::LINF);
+	void setOutputDir(const std::string& dir);
+	void setThreads(int threads);
+	void setLanes(int lanes);
+
+	static std::vector<Case> grid(const std::vector<double>& viscosities, const std::vector<double>& u0s);
+
+	std::vector<Result> run(const std::vector<Case>& cases);
+
+	double seconds();
+	double mlups();
+};
+
+#endif // SWEEP_HPP
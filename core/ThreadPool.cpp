@@ -0,0 +1,218 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Index of the pool worker running on this thread, -1 outside any pool.
+static thread_local int currentWorker = -1;
+static thread_local const ThreadPool* currentPool = nullptr;
+
+/**
+ * @brief Pins a thread to the index-th CPU the process may run on, wrapping around.
+ */
+static void pinToCpu(std::thread& thread, int index) {
+#ifdef __linux__
+	cpu_set_t allowed;
+	if(sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+		return;
+	}
+	index %= CPU_COUNT(&allowed);
+	for(int cpu = 0;cpu < CPU_SETSIZE;cpu++) {
+		if(CPU_ISSET(cpu, &allowed) && index-- == 0) {
+			cpu_set_t one;
+			CPU_ZERO(&one);
+			CPU_SET(cpu, &one);
+			pthread_setaffinity_np(thread.native_handle(), sizeof(one), &one);
+			return;
+		}
+	}
+#else
+	(void)thread;
+	(void)index;
+#endif
+}
+
+/**
+ * @brief Starts the workers.
+ * @param threads	number of workers, 0 for one per hardware thread
+ * @param pin		pin worker i to the i-th CPU the process is allowed on (Linux only; ignored
+ *					elsewhere or if the affinity cannot be set)
+ */
+ThreadPool::ThreadPool(int threads, bool pin) {
+	if(threads <= 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	for(int i = 0;i < threads;i++) {
+		_queues.emplace_back(new Queue);
+	}
+	for(int i = 0;i < threads;i++) {
+		_threads.emplace_back(&ThreadPool::run, this, i);
+		if(pin) {
+			pinToCpu(_threads.back(), i);
+		}
+	}
+}
+
+/**
+ * @brief Finishes every queued task and joins the workers.
+ */
+ThreadPool::~ThreadPool() {
+	wait();
+
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_stop = true;
+	}
+	_wake.notify_all();
+
+	for(auto& t : _threads) {
+		t.join();
+	}
+}
+
+/**
+ * @brief Queues a task.
+ */
+void ThreadPool::submit(std::function<void()> task) {
+	size_t target;
+	if(currentPool == this) {
+		target = currentWorker;
+	} else {
+		std::lock_guard<std::mutex> lock(_mutex);
+		target = _next++ % _queues.size();
+	}
+	submit(target, std::move(task));
+}
+
+/**
+ * @brief Queues a task on a given worker, e.g. the one whose memory it works on. Idle workers
+ * may still steal it.
+ */
+void ThreadPool::submit(int worker, std::function<void()> task) {
+	size_t target = worker % _queues.size();
+
+	// Count the task before it becomes visible so a worker that steals it never sees the
+	// counters go negative.
+	_pending++;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_queued++;
+	}
+	{
+		std::lock_guard<std::mutex> lock(_queues[target]->mutex);
+		_queues[target]->tasks.push_back(std::move(task));
+	}
+	_wake.notify_one();
+}
+
+/**
+ * @brief Runs a task once on every worker, each on its own thread, and waits for all of them;
+ * e.g. to first-touch the memory each worker will use. Must not be called from a worker.
+ * @param task	called with the index of the worker running it
+ */
+void ThreadPool::runOnEach(std::function<void(int worker)> task) {
+	for(size_t i = 0;i < _queues.size();i++) {
+		_pending++;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_queues[i]->boundQueued++;
+		}
+		{
+			std::lock_guard<std::mutex> lock(_queues[i]->mutex);
+			_queues[i]->bound.push_back([task, i] { task(i); });
+		}
+	}
+	_wake.notify_all();
+	wait();
+}
+
+/**
+ * @brief Blocks until every submitted task has finished. Must not be called from a worker.
+ */
+void ThreadPool::wait() {
+	std::unique_lock<std::mutex> lock(_mutex);
+	_idle.wait(lock, [this] { return _pending == 0; });
+}
+
+/**
+ * @brief ThreadPool::size
+ * @return the number of workers
+ */
+int ThreadPool::size() const {
+	return _threads.size();
+}
+
+/**
+ * @brief Takes a task from the worker's own queue, or steals one from another worker, and
+ * uncounts it.
+ * @return false if every queue was empty
+ */
+bool ThreadPool::pop(int worker, std::function<void()>& task) {
+	{
+		Queue& own = *_queues[worker];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if(!own.bound.empty()) {
+			task = std::move(own.bound.front());
+			own.bound.pop_front();
+			own.boundQueued--;
+			return true;
+		}
+		if(!own.tasks.empty()) {
+			task = std::move(own.tasks.back());
+			own.tasks.pop_back();
+			_queued--;
+			return true;
+		}
+	}
+
+	for(size_t i = 1;i < _queues.size();i++) {
+		Queue& other = *_queues[(worker + i) % _queues.size()];
+		std::lock_guard<std::mutex> lock(other.mutex);
+		if(!other.tasks.empty()) {
+			task = std::move(other.tasks.front());
+			other.tasks.pop_front();
+			_queued--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * @brief Worker loop.
+ */
+void ThreadPool::run(int worker) {
+	currentWorker = worker;
+	currentPool = this;
+
+	// Only wake for work this worker can take: stealable tasks or its own bound ones. Workers done
+	// with their part of runOnEach() sleep instead of polling the others' queues.
+	Queue& own = *_queues[worker];
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_wake.wait(lock, [this, &own] { return _stop || _queued > 0 || own.boundQueued > 0; });
+			if(_stop && _queued == 0 && own.boundQueued == 0) {
+				return;
+			}
+		}
+
+		std::function<void()> task;
+		if(!pop(worker, task)) {
+			continue;
+		}
+
+		task();
+
+		if(--_pending == 0) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_idle.notify_all();
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads with one task queue each.
+ *
+ * A worker takes new work from the back of its own queue and, when that runs dry, steals from
+ * the front of the others. Tasks submitted from inside a worker go to that worker's queue.
+ *
+ * Workers can be pinned to one CPU each, so memory a worker first touched stays on its NUMA node
+ * and the worker stays next to it.
+ */
+class ThreadPool {
+	struct Queue {
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+		std::deque<std::function<void()>> bound;	// only this worker may run these
+		std::atomic<size_t> boundQueued{0};			// bound tasks not yet taken
+	};
+
+	std::vector<std::unique_ptr<Queue>> _queues;
+	std::vector<std::thread> _threads;
+
+	std::mutex _mutex;
+	std::condition_variable _wake;		// signalled when work is queued or the pool stops
+	std::condition_variable _idle;		// signalled when the last pending task finishes
+	std::atomic<size_t> _queued{0};		// stealable tasks sitting in queues
+	std::atomic<size_t> _pending{0};	// tasks queued or running
+	size_t _next = 0;					// round-robin target for submissions from outside
+	bool _stop = false;
+
+	bool pop(int worker, std::function<void()>& task);
+	void run(int worker);
+
+public:
+	explicit ThreadPool(int threads = 0, bool pin = false);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	void submit(std::function<void()> task);
+	void submit(int worker, std::function<void()> task);
+	void runOnEach(std::function<void(int worker)> task);
+	void wait();
+	int size() const;
+};
+
+#endif // THREADPOOL_HPP
@@ -0,0 +1,134 @@
+#include "Tracer.hpp"
+#include "Profiler.hpp"
+
+#include <fstream>
+
+Tracer::Tracer() {
+}
+
+/**
+ * @brief Tracer::instance
+ * @return the process-wide tracer
+ */
+Tracer& Tracer::instance() {
+	static Tracer tracer;
+	return tracer;
+}
+
+/**
+ * @brief Starts or stops recording. Events already recorded are kept.
+ */
+void Tracer::setEnabled(bool enabled) {
+	_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Finds the calling thread's buffer, registering it on first use.
+ *
+ * Buffers are never freed; a thread that exits leaves its events behind for write().
+ */
+Tracer::ThreadBuffer* Tracer::buffer() {
+	thread_local ThreadBuffer* local = nullptr;
+
+	if(!local) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		local = new ThreadBuffer;
+		local->tid = _buffers.size() + 1;
+		local->name = "thread " + std::to_string(local->tid);
+		local->head = new Chunk;
+		local->tail = local->head;
+		_buffers.push_back(local);
+	}
+
+	return local;
+}
+
+/**
+ * @brief Names the calling thread in the written trace.
+ */
+void Tracer::setThreadName(const std::string& name) {
+	ThreadBuffer* b = buffer();
+	std::lock_guard<std::mutex> lock(_mutex);
+	b->name = name;
+}
+
+/**
+ * @brief Appends an event to the calling thread's buffer.
+ * @param name	the event name; the pointer is stored, not the string
+ * @param start	start time in seconds on the Profiler clock
+ * @param end	end time in seconds on the Profiler clock
+ */
+void Tracer::record(const char* name, double start, double end) {
+	ThreadBuffer* b = buffer();
+	Chunk* chunk = b->tail;
+
+	size_t n = chunk->count.load(std::memory_order_relaxed);
+	if(n == CHUNK_SIZE) {
+		Chunk* next = new Chunk;
+		chunk->next.store(next, std::memory_order_release);
+		b->tail = next;
+		chunk = next;
+		n = 0;
+	}
+
+	chunk->events[n] = {name, start, end};
+	chunk->count.store(n + 1, std::memory_order_release);
+}
+
+/**
+ * @brief Writes every recorded event as Chrome trace-event JSON.
+ * @return false if the file could not be written
+ */
+bool Tracer::write(const std::string& path) {
+	std::ofstream out(path);
+	if(!out) {
+		return false;
+	}
+
+	std::vector<ThreadBuffer*> buffers;
+	std::vector<std::string> names;
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		buffers = _buffers;
+		for(auto b : buffers) {
+			names.push_back(b->name);
+		}
+	}
+
+	out << "{\"traceEvents\": [\n";
+	bool first = true;
+	for(size_t i = 0;i < buffers.size();i++) {
+		ThreadBuffer* b = buffers[i];
+
+		out << (first ? "" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+			<< b->tid << ", \"args\": {\"name\": \"" << names[i] << "\"}}";
+		first = false;
+
+		for(Chunk* c = b->head;c;c = c->next.load(std::memory_order_acquire)) {
+			size_t n = c->count.load(std::memory_order_acquire);
+			for(size_t j = 0;j < n;j++) {
+				const Event& e = c->events[j];
+				out << ",\n{\"name\": \"" << e.name << "\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << b->tid
+					<< ", \"ts\": " << (long long)(e.start * 1e6)
+					<< ", \"dur\": " << (long long)((e.end - e.start) * 1e6) << "}";
+			}
+		}
+	}
+	out << "\n], \"displayTimeUnit\": \"ms\"}\n";
+
+	return bool(out);
+}
+
+TraceScope::TraceScope(const char* name) : _name(name), _start(0) {
+	if(Tracer::instance().enabled()) {
+		_start = Profiler::instance().now();
+	} else {
+		_name = nullptr;
+	}
+}
+
+TraceScope::~TraceScope() {
+	if(_name) {
+		Tracer::instance().record(_name, _start, Profiler::instance().now());
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef TRACER_HPP
+#define TRACER_HPP
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Opt-in recorder of scoped events, written out in the Chrome trace-event format so a run can be
+ * inspected in Perfetto or chrome://tracing.
+ *
+ * Every thread appends to its own buffer, so recording never takes a lock. Buffers are chains of
+ * fixed-size chunks that are only ever appended to; write() can read them while other threads are
+ * still recording.
+ */
+class Tracer {
+public:
+	struct Event {
+		const char* name;	// must outlive the tracer, e.g. a string literal
+		double start;		// seconds on the Profiler clock
+		double end;
+	};
+
+private:
+	static constexpr size_t CHUNK_SIZE = 4096;
+
+	struct Chunk {
+		Event events[CHUNK_SIZE];
+		std::atomic<size_t> count{0};
+		std::atomic<Chunk*> next{nullptr};
+	};
+
+	struct ThreadBuffer {
+		int tid;
+		std::string name;
+		Chunk* head;
+		Chunk* tail;
+	};
+
+	std::atomic<bool> _enabled{false};
+	std::mutex _mutex;					// guards registration of thread buffers only
+	std::vector<ThreadBuffer*> _buffers;
+
+	Tracer();
+	ThreadBuffer* buffer();
+
+public:
+	static Tracer& instance();
+
+	bool enabled() const {
+		return _enabled.load(std::memory_order_relaxed);
+	}
+	void setEnabled(bool enabled);
+
+	void setThreadName(const std::string& name);
+	void record(const char* name, double start, double end);
+
+	bool write(const std::string& path);
+};
+
+/**
+ * Records the enclosing scope as one trace event if tracing is enabled.
+ */
+class TraceScope {
+	const char* _name;
+	double _start;
+
+public:
+	explicit TraceScope(const char* name);
+	~TraceScope();
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name)
+
+#endif // TRACER_HPP
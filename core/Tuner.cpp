@@ -0,0 +1,320 @@
+#include "Tuner.hpp"
+#include "Tracer.hpp"
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+static const char* const PRECISION_NAMES[] = {"double", "single", "half"};
+
+/**
+ * @brief The allowed precisions as written in the cache, in enum order so the order they were
+ * passed in does not matter.
+ */
+static std::string precisionList(const std::vector<ShiftedLattice::Precision>& precisions) {
+	std::string list;
+	for(int p = ShiftedLattice::DOUBLE;p <= ShiftedLattice::HALF;p++) {
+		if(std::find(precisions.begin(), precisions.end(), (ShiftedLattice::Precision)p) != precisions.end()) {
+			list += (list.empty() ? "" : ",") + std::string(PRECISION_NAMES[p]);
+		}
+	}
+	return list;
+}
+
+/**
+ * @param cacheFile	where winners are kept, or empty to neither read nor write a cache
+ */
+Tuner::Tuner(const std::string& cacheFile) : _cacheFile(cacheFile) {
+}
+
+/**
+ * @brief Sets how many steps of each candidate are timed, after two untimed ones. By default
+ * about four million cell updates' worth, at least 3 and at most 50 steps.
+ */
+void Tuner::setSteps(int steps) {
+	_steps = std::max(steps, 0);
+}
+
+/**
+ * @brief The variant stored for this host and grid, if any.
+ */
+boost::optional<Tuner::Variant> Tuner::cached(int height, int width,
+											  const std::vector<ShiftedLattice::Precision>& precisions) {
+	std::string cpu = cpuModel();
+	std::string list = precisionList(precisions);
+	for(auto& e : read()) {
+		if(e.cpu == cpu && e.height == height && e.width == width && e.precisions == list) {
+			return e.variant;
+		}
+	}
+	return boost::none;
+}
+
+/**
+ * @brief Times every candidate on a geometry and returns the fastest. Nothing is stored, see
+ * store().
+ *
+ * @param geometry		the state to step; must be one ShiftedLattice supports
+ * @param precisions	precisions to choose from
+ * @return the fastest variant, none if no precision was given
+ */
+boost::optional<Tuner::Variant> Tuner::tune(const SimState& geometry, const std::vector<ShiftedLattice::Precision>& precisions) {
+	TRACE_SCOPE("tune");
+
+	long cells = (long)geometry.height * geometry.width;
+	int steps = _steps > 0 ? _steps : (int)std::min(std::max(4000000 / std::max(cells, 1L), 3L), 50L);
+
+	boost::optional<Variant> best;
+	for(auto& candidate : candidates(geometry.height, geometry.width, precisions)) {
+		double seconds = measure(geometry, candidate, steps);
+		double mlups = seconds > 0 ? cells / seconds / 1e6 : 0;
+		if(!best || mlups > best->mlups) {
+			best = candidate;
+			best->mlups = mlups;
+		}
+	}
+	return best;
+}
+
+/**
+ * @brief The variants tune() tries: each allowed precision with a few tile shapes and with one
+ * thread, then doubling up to one per hardware thread.
+ */
+std::vector<Tuner::Variant> Tuner::candidates(int height, int width,
+											  const std::vector<ShiftedLattice::Precision>& precisions) {
+	// Square tiles of three sizes, and tall ones, which stream along whole columns.
+	const int shapes[][2] = {{32, 32}, {64, 64}, {128, 128}, {256, 32}};
+
+	std::vector<std::pair<int, int>> tiles;
+	for(auto& shape : shapes) {
+		// ShiftedLattice clamps tiles to the grid, so small grids have fewer distinct shapes.
+		std::pair<int, int> tile(std::min(shape[0], height), std::min(shape[1], width));
+		if(std::find(tiles.begin(), tiles.end(), tile) == tiles.end()) {
+			tiles.push_back(tile);
+		}
+	}
+
+	int cores = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<int> threads;
+	for(int n = 1;n < cores;n *= 2) {
+		threads.push_back(n);
+	}
+	threads.push_back(cores);
+
+	std::vector<Variant> variants;
+	for(int p = ShiftedLattice::DOUBLE;p <= ShiftedLattice::HALF;p++) {
+		if(std::find(precisions.begin(), precisions.end(), (ShiftedLattice::Precision)p) == precisions.end()) {
+			continue;
+		}
+		for(auto& tile : tiles) {
+			for(int n : threads) {
+				variants.push_back({(ShiftedLattice::Precision)p, tile.first, tile.second, n, 0});
+			}
+		}
+	}
+	return variants;
+}
+
+/**
+ * @brief Steps a lattice built with a variant and measures it.
+ * @return the median wall time of a step in seconds
+ */
+double Tuner::measure(const SimState& geometry, const Variant& variant, int steps) {
+	ShiftedLattice lattice(geometry, variant.precision);
+	lattice.setTileSize(variant.tileRows, variant.tileCols);
+	lattice.setThreads(variant.threads);
+
+	// The first steps fault in pages and wake the workers.
+	lattice.step();
+	lattice.step();
+
+	std::vector<double> times;
+	for(int i = 0;i < steps;i++) {
+		auto start = std::chrono::steady_clock::now();
+		lattice.step();
+		times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	std::nth_element(times.begin(), times.begin() + times.size() / 2, times.end());
+	return times[times.size() / 2];
+}
+
+/**
+ * @brief Remembers a variant for this host and grid, replacing what was stored for them.
+ * @return false if the cache file could not be written
+ */
+bool Tuner::store(int height, int width, const std::vector<ShiftedLattice::Precision>& precisions,
+				  const Variant& variant) {
+	if(_cacheFile.empty()) {
+		return false;
+	}
+
+	Entry entry = {cpuModel(), height, width, precisionList(precisions), variant};
+	auto entries = read();
+	auto same = std::find_if(entries.begin(), entries.end(), [&](const Entry& e) {
+		return e.cpu == entry.cpu && e.height == height && e.width == width && e.precisions == entry.precisions;
+	});
+	if(same != entries.end()) {
+		*same = entry;
+	} else {
+		entries.push_back(entry);
+	}
+	return write(entries);
+}
+
+/**
+ * @brief Every entry of the cache file. Lines that do not parse are skipped, so a damaged file
+ * only costs a new tuning run.
+ */
+std::vector<Tuner::Entry> Tuner::read() {
+	std::vector<Entry> entries;
+	if(_cacheFile.empty()) {
+		return entries;
+	}
+
+	std::ifstream file(_cacheFile);
+	std::string line;
+	while(std::getline(file, line)) {
+		if(line.empty() || line[0] == '#') {
+			continue;
+		}
+
+		// cpu, height, width, allowed precisions, variant, MLUPS; the CPU name has spaces
+		std::vector<std::string> fields;
+		std::stringstream stream(line);
+		std::string field;
+		while(std::getline(stream, field, '\t')) {
+			fields.push_back(field);
+		}
+		if(fields.size() != 6) {
+			continue;
+		}
+
+		Entry e;
+		e.cpu = fields[0];
+		e.precisions = fields[3];
+		char* end;
+		e.height = std::strtol(fields[1].c_str(), &end, 10);
+		e.width = std::strtol(fields[2].c_str(), &end, 10);
+		if(!parse(fields[4], e.variant)) {
+			continue;
+		}
+		e.variant.mlups = std::strtod(fields[5].c_str(), &end);
+		entries.push_back(e);
+	}
+	return entries;
+}
+
+/**
+ * @brief Replaces the cache file. It is written to a file of its own next to the old one and
+ * renamed over it, so runs tuning at the same time never see half a file; the last one to
+ * finish wins.
+ */
+bool Tuner::write(const std::vector<Entry>& entries) {
+	std::string temp = _cacheFile + ".XXXXXX";
+	int fd = mkstemp(&temp[0]);
+	if(fd < 0) {
+		return false;
+	}
+	fchmod(fd, 0644);	// mkstemp() creates it private
+	close(fd);
+
+	{
+		std::ofstream file(temp);
+		file << "# vizualizer tuning cache: cpu, height, width, allowed precisions, variant, MLUPS\n";
+		for(auto& e : entries) {
+			file << e.cpu << '\t' << e.height << '\t' << e.width << '\t' << e.precisions << '\t'
+				 << format(e.variant) << '\t' << e.variant.mlups << '\n';
+		}
+		if(!file) {
+			std::remove(temp.c_str());
+			return false;
+		}
+	}
+	if(std::rename(temp.c_str(), _cacheFile.c_str()) != 0) {
+		std::remove(temp.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief $XDG_CACHE_HOME/vizualizer-tuning, falling back to ~/.cache; empty if neither is set.
+ * The directory is created if missing.
+ */
+std::string Tuner::defaultCacheFile() {
+	std::string dir;
+	if(const char* cache = std::getenv("XDG_CACHE_HOME")) {
+		dir = cache;
+	} else if(const char* home = std::getenv("HOME")) {
+		dir = std::string(home) + "/.cache";
+	}
+	if(dir.empty()) {
+		return "";
+	}
+	mkdir(dir.c_str(), 0755);
+	return dir + "/vizualizer-tuning";
+}
+
+/**
+ * @brief The CPU model from /proc/cpuinfo, or "unknown".
+ */
+std::string Tuner::cpuModel() {
+	std::ifstream cpuinfo("/proc/cpuinfo");
+	std::string line;
+	while(std::getline(cpuinfo, line)) {
+		if(line.compare(0, 10, "model name") == 0) {
+			auto colon = line.find(':');
+			if(colon != std::string::npos && colon + 2 <= line.size()) {
+				return line.substr(colon + 2);
+			}
+		}
+	}
+	return "unknown";
+}
+
+/**
+ * @brief A variant as accepted by parse(), e.g. "single,64x64,4".
+ */
+std::string Tuner::format(const Variant& variant) {
+	return std::string(PRECISION_NAMES[variant.precision]) + "," + std::to_string(variant.tileRows) + "x"
+		   + std::to_string(variant.tileCols) + "," + std::to_string(variant.threads);
+}
+
+/**
+ * @brief Parses "precision,RxC,threads", e.g. "single,64x64,4"; threads 0 is one per core.
+ * @return false if the text is malformed
+ */
+bool Tuner::parse(const std::string& text, Variant& variant) {
+	auto first = text.find(',');
+	auto second = text.find(',', first == std::string::npos ? first : first + 1);
+	if(first == std::string::npos || second == std::string::npos) {
+		return false;
+	}
+
+	std::string name = text.substr(0, first);
+	auto p = std::find_if(std::begin(PRECISION_NAMES), std::end(PRECISION_NAMES),
+						  [&](const char* n) { return name == n; });
+	if(p == std::end(PRECISION_NAMES)) {
+		return false;
+	}
+
+	int rows, cols, threads;
+	char x;
+	char extra;
+	std::stringstream tile(text.substr(first + 1, second - first - 1));
+	std::stringstream count(text.substr(second + 1));
+	if(!(tile >> rows >> x >> cols) || x != 'x' || tile >> extra || !(count >> threads) || count >> extra
+			|| rows < 1 || cols < 1 || threads < 0) {
+		return false;
+	}
+
+	variant = {(ShiftedLattice::Precision)(p - std::begin(PRECISION_NAMES)), rows, cols, threads, 0};
+	return true;
+}
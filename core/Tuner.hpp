@@ -0,0 +1,65 @@
+#ifndef TUNER_HPP
+#define TUNER_HPP
+
+#include "ShiftedLattice.hpp"
+#include "SimState.hpp"
+
+#include <boost/optional.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+ * Picks the fastest way to step a grid with ShiftedLattice on this host.
+ *
+ * tune() builds the lattice with every candidate variant (precision, tile size and thread
+ * count), times a few steps of each and keeps the fastest. Winners are stored in a cache file,
+ * one line per CPU model, grid size and set of allowed precisions, so later runs on the same host
+ * and grid pick them up without timing anything. Tile size and thread count never change the
+ * result; precision does, so it is only chosen among the precisions the caller allows.
+ */
+class Tuner {
+public:
+	struct Variant {
+		ShiftedLattice::Precision precision;
+		int tileRows;
+		int tileCols;
+		int threads;
+		double mlups;	// measured by tune(), 0 if unknown
+	};
+
+private:
+	struct Entry {
+		std::string cpu;
+		int height;
+		int width;
+		std::string precisions;
+		Variant variant;
+	};
+
+	std::string _cacheFile;
+	int _steps = 0;			// steps timed per candidate, 0 picks them from the grid size
+
+	std::vector<Entry> read();
+	bool write(const std::vector<Entry>& entries);
+	std::vector<Variant> candidates(int height, int width, const std::vector<ShiftedLattice::Precision>& precisions);
+	double measure(const SimState& geometry, const Variant& variant, int steps);
+
+public:
+	explicit Tuner(const std::string& cacheFile = defaultCacheFile());
+
+	void setSteps(int steps);
+
+	boost::optional<Variant> cached(int height, int width, const std::vector<ShiftedLattice::Precision>& precisions);
+	boost::optional<Variant> tune(const SimState& geometry, const std::vector<ShiftedLattice::Precision>& precisions);
+	bool store(int height, int width, const std::vector<ShiftedLattice::Precision>& precisions,
+			   const Variant& variant);
+
+	static std::string defaultCacheFile();
+	static std::string cpuModel();
+
+	static std::string format(const Variant& variant);
+	static bool parse(const std::string& text, Variant& variant);
+};
+
+#endif // TUNER_HPP
@@ -0,0 +1,64 @@
+# The lattice Boltzmann engine, frames and .istate serialization. No Qt, so batch services and
+# tests can link it without QtWidgets/QtOpenGL.
+
+QMAKE_CXXFLAGS += -std=gnu++14 -g -fsanitize=undefined
+
+QMAKE_CXXFLAGS_DEBUG += -pg
+
+INCLUDEPATH += /usr/local/include
+
+TEMPLATE = lib
+CONFIG += staticlib
+CONFIG -= qt
+TARGET = fluidcore
+DEPENDPATH += .
+INCLUDEPATH += .
+
+QMAKE_CXX = clang++
+
+SOURCES += SimState.cpp \
+    Frame.cpp \
+    FramePool.cpp \
+    DataStream.cpp \
+    Headless.cpp \
+    Profiler.cpp \
+    Tracer.cpp \
+    ThreadPool.cpp \
+    Sweep.cpp \
+    Ensemble.cpp \
+    Checkpointer.cpp \
+    Shape.cpp \
+    Obstacle.cpp \
+    Geometry.cpp \
+    FrameCodec.cpp \
+    FrameServer.cpp \
+    FrameRing.cpp \
+    MultiBlock.cpp \
+    MomentLattice.cpp \
+    ShiftedLattice.cpp \
+    PageBuffer.cpp \
+    Tuner.cpp
+HEADERS += FluidCore.hpp \
+    SimState.hpp \
+    Frame.hpp \
+    FramePool.hpp \
+    DataStream.hpp \
+    Headless.hpp \
+    Profiler.hpp \
+    Tracer.hpp \
+    ThreadPool.hpp \
+    Sweep.hpp \
+    Ensemble.hpp \
+    Checkpointer.hpp \
+    Shape.hpp \
+    Obstacle.hpp \
+    Lattice.hpp \
+    Geometry.hpp \
+    FrameCodec.hpp \
+    FrameServer.hpp \
+    FrameRing.hpp \
+    MultiBlock.hpp \
+    MomentLattice.hpp \
+    ShiftedLattice.hpp \
+    PageBuffer.hpp \
+    Tuner.hpp
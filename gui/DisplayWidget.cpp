@@ -1,4 +1,6 @@
 #include "DisplayWidget.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
 
 #include <QMouseEvent>
 
@@ -21,6 +23,14 @@ DisplayWidget::DisplayWidget(QWidget* parent) : QGLWidget(parent) {
     update();
 }
 
+DisplayWidget::~DisplayWidget() {
+    makeCurrent();
+    if(_texture)
+        glDeleteTextures(1, &_texture);
+    if(_vectorLists)
+        glDeleteLists(_vectorLists, _vectorBands);
+}
+
 /**
  * @brief Handles when the mouse leaves the widget.
  */
@@ -43,9 +53,9 @@ void DisplayWidget::emitHover() {
             return;
         }
 
-        float ux = frame->ux.at(row, col);
-        float uy = frame->uy.at(row, col);
-        float density = frame->density.at(row, col);
+        float ux = frame->ux().at(row, col);
+        float uy = frame->uy().at(row, col);
+        float density = frame->density().at(row, col);
         float speed = sqrt(ux*ux + uy*uy);
 
         auto s = QString("");
@@ -73,14 +83,22 @@ void DisplayWidget::mouseMoveEvent(QMouseEvent* event) {
         emitHover();
     }
     else if(interactionMode == SELECT) {
+        QRect old = selection();
         cur_row = row;
         cur_col = col;
-        update();
+
+        // Redraw the cells that left or entered the selection.
+        QRect now = selection();
+        if(now != old) {
+            QRect both = old | now;
+            invalidate(both.top(), both.left(), both.height(), both.width(), false);
+            update();
+        }
     } else if(interactionMode == TOGGLE){
         if(row != cur_row || col != cur_col) {
             cur_row = row;
             cur_col = col;
-            emit toggle(row, col);
+            emit drag(row, col);
         }
     }
 }
@@ -97,6 +115,7 @@ void DisplayWidget::mousePressEvent(QMouseEvent* event) {
 
     if(event->modifiers() == Qt::ShiftModifier) {
         interactionMode = SELECT;
+        invalidate(cur_row, cur_col, 1, 1, false);
         update();
     } else {
         interactionMode = TOGGLE;
@@ -110,9 +129,13 @@ void DisplayWidget::mousePressEvent(QMouseEvent* event) {
  */
 void DisplayWidget::mouseReleaseEvent(QMouseEvent* event) {
     if(interactionMode == SELECT) {
+        QRect old = selection();
+        interactionMode = NONE;
+        invalidate(old.top(), old.left(), old.height(), old.width(), false);
+        update();
+
         cur_row = getRow(event->y());
         cur_col = getCol(event->x());
-        update();
 
         int r1 = start_row;
         int r2 = cur_row;
@@ -213,6 +236,7 @@ void DisplayWidget::initializeGL()
  */
 void DisplayWidget::paintGL()
 {
+    TRACE_SCOPE("paintGL");
     glMatrixMode(GL_MODELVIEW);
     glClear(GL_COLOR_BUFFER_BIT);
     glLoadIdentity();
@@ -260,11 +284,6 @@ void DisplayWidget::resizeGL(int width, int height)
 		vp_height = width / aspect_ratio;
     }
 
-    qDebug() << "Resize" << this;/*
-    qDebug() << range_x << range_y;
-    qDebug() << vp_x_off << vp_y_off;
-    qDebug() << vp_width << vp_height;*/
-	
     glMatrixMode(GL_PROJECTION);
     glViewport(
         vp_x_off,
@@ -315,179 +334,229 @@ static void square(float x, float y, float w, float h){
 }
 
 /**
- * @brief Draws the vectors and heatmap based on the current Frame.
+ * @brief Recomputes the color range of the current heatmap type over the whole frame.
  */
-void DisplayWidget::draw(){
-
-    qDebug() << "Draw" << this;/*
-    qDebug() << range_x << range_y;
-    qDebug() << vp_x_off << vp_y_off;
-    qDebug() << vp_width << vp_height;*/
-
-	// Determine drawing box coordinates.
-	float minx = range_x * MARGIN;
-	float maxx = range_x * (1 - MARGIN);
-	float miny = range_y * MARGIN;
-	float maxy = range_y * (1 - MARGIN);
-	
-	// Check that the vector field has been set.
-	if(!frame)
-		return;
-	
-	// Determine the step size of the grid.
-	float stepx = (maxx - minx) / frame->width;
-	float stepy = (maxy - miny) / frame->height;
-	
-	// Scale of vectors.
-	float scale = stepx / 3;
-	
-	// Find max and min lengths so we can normalize vector length.
-	// Lengths are also used in speed heat map.
-	QVector<float> lengths;
-	lengths.resize(frame->height * frame->width); // Pre-resize vector. This is efficient.
-	float max_len;
-	float min_len;
-	for(int i = 0;i < frame->height * frame->width;i++){
-		float u = frame->ux.at(i);
-		float v = frame->uy.at(i);
-		float len = std::sqrt(u*u + v*v);
-		lengths[i] = len;
-		
-		if(i == 0){
-			max_len = len;
-			min_len = len;
-		}
-		else if(len > max_len){
-			max_len = len;
-		}
-		else if(len < min_len){
-			min_len = len;
-		}
-	}
-	
-    auto getHue = [](float n) -> int {
-        Q_ASSERT(n >= 0 && n <= 1);
-        return (int)(240 - n * 240);
-    };
-
-	// Draw the heat map.
-	int i = 0;
-    float maxDensity = 0;
-    float minDensity = 0;
-    float maxSpeed = 0;
-    float minSpeed = 0;
-    float maxUx = 0;
-    float minUx = 0;
-    float maxUy = 0;
-    float minUy = 0;
-
-
+void DisplayWidget::updateRange() {
     if(heatmapType == DENSITY) {
-        maxDensity = frame->density.max();
-        minDensity = frame->density.min();
-
-        if(maxDensity == minDensity) {
-            maxDensity += .01;
-        }
+        _maxValue = frame->density().max();
+        _minValue = frame->density().min();
     } else if(heatmapType == SPEED) {
-        maxSpeed = max_len;
-        minSpeed = min_len;
-
-        if(maxSpeed == minSpeed) {
-            maxSpeed += .01;
+        for(int i = 0;i < frame->height * frame->width;i++){
+            float u = frame->ux().at(i);
+            float v = frame->uy().at(i);
+            float len = std::sqrt(u*u + v*v);
+
+            if(i == 0 || len > _maxValue)
+                _maxValue = len;
+            if(i == 0 || len < _minValue)
+                _minValue = len;
         }
     } else if(heatmapType == X_VEL) {
-        maxUx = frame->ux.max();
-        minUx = frame->ux.min();
-
-        if(maxUx == minUx) {
-            maxUx += .01;
-        }
+        _maxValue = frame->ux().max();
+        _minValue = frame->ux().min();
     } else if(heatmapType == Y_VEL) {
-        maxUy = frame->uy.max();
-        minUy = frame->uy.min();
-
-        if(maxUy == minUy) {
-            maxUy += .01;
-        }
+        _maxValue = frame->uy().max();
+        _minValue = frame->uy().min();
     } else {
         Q_ASSERT(false);
     }
 
-    for(int xi = 0;xi < frame->width;xi++){
-        for(int yi = 0;yi < frame->height;yi++, i++){
-            int hue;
-			float x = minx + stepx  * xi + stepx / 2;
-            float y = miny + stepy  * yi + stepy / 2;
-			
-			if(!frame->getBarrier(yi, xi)){
-    			// If it's not a barrier, draw a color square.
+    if(_maxValue == _minValue) {
+        _maxValue += .01;
+    }
+}
+
+/**
+ * @brief Redraws a rectangle of cells into the cached heatmap.
+ * @param rect	cells to redraw, x = col and y = row
+ */
+void DisplayWidget::rasterize(const QRect& rect) {
+    auto getHue = [](float n) -> int {
+        Q_ASSERT(n >= 0 && n <= 1);
+        return (int)(240 - n * 240);
+    };
+
+    QRect selected = selection();
+
+    for(int yi = rect.top();yi <= rect.bottom();yi++) {
+        unsigned char* pixel = &_pixels[4 * (yi * frame->width + rect.left())];
+        for(int xi = rect.left();xi <= rect.right();xi++, pixel += 4) {
+            int i = xi * frame->height + yi;
+            QColor color;
+
+            if(!frame->getBarrier(yi, xi)) {
+                // If it's not a barrier, color by the heatmap.
+                float value;
                 if(heatmapType == DENSITY) {
-                    auto density = frame->density[i];
-                    hue = getHue((density - minDensity) / (maxDensity - minDensity));
+                    value = frame->density()[i];
                 } else if(heatmapType == SPEED) {
-                    float len = lengths[i];
-                    hue = getHue((len - minSpeed) / (maxSpeed - minSpeed));
+                    float u = frame->ux()[i];
+                    float v = frame->uy()[i];
+                    value = std::sqrt(u*u + v*v);
                 } else if(heatmapType == X_VEL) {
-                    float ux = frame->ux[i];
-                    hue = getHue((ux - minUx) / (maxUx - minUx));
+                    value = frame->ux()[i];
                 } else if(heatmapType == Y_VEL) {
-                    float uy = frame->uy[i];
-                    hue = getHue((uy - minUy) / (maxUy - minUy));
+                    value = frame->uy()[i];
                 } else {
                     Q_ASSERT(false);
-                    hue = 0;
+                    value = _minValue;
                 }
+                int hue = getHue((value - _minValue) / (_maxValue - _minValue));
 
-                if(interactionMode == SELECT &&
-                        xi >= std::min({cur_col, start_col}) &&
-                        xi <= std::max({cur_col, start_col}) &&
-                        yi >= std::min({cur_row, start_row}) &&
-                        yi <= std::max({cur_row, start_row})) {
-                    qglColor(QColor::fromHsv(hue, 160, 240));
+                if(selected.contains(xi, yi)) {
+                    color = QColor::fromHsv(hue, 160, 240);
                 } else {
-                    qglColor(QColor::fromHsv(hue, 240, 200));
+                    color = QColor::fromHsv(hue, 240, 200);
                 }
-                square(x, y, stepx, stepy);
-			}
-			else{
-				// If it's a barrier, draw gray.
-				qglColor(Qt::gray);
-				square(x, y, stepx, stepy);
-			}
-		}
-	}
+            }
+            else {
+                // If it's a barrier, draw gray.
+                color = QColor(Qt::gray);
+            }
+
+            pixel[0] = color.red();
+            pixel[1] = color.green();
+            pixel[2] = color.blue();
+            pixel[3] = 255;
+        }
+    }
+}
+
+/**
+ * @brief Brings the cached heatmap and its texture up to date with the dirty cells. Must be
+ * called with the GL context current.
+ */
+void DisplayWidget::render() {
+    if(_dirty.empty())
+        return;
+
+    PROFILE_SCOPE("rasterize");
+
+    if(!_texture || _textureRows != frame->height || _textureCols != frame->width) {
+        if(!_texture)
+            glGenTextures(1, &_texture);
+        glBindTexture(GL_TEXTURE_2D, _texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frame->width, frame->height, 0,
+                     GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        _textureRows = frame->height;
+        _textureCols = frame->width;
+
+        _dirty.assign(1, QRect(0, 0, frame->width, frame->height));
+    }
+
+    glBindTexture(GL_TEXTURE_2D, _texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->width);
+    for(const QRect& rect : _dirty) {
+        rasterize(rect);
+
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.top());
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.left());
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.left(), rect.top(), rect.width(), rect.height(),
+                        GL_RGBA, GL_UNSIGNED_BYTE, _pixels.data());
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+
+    _dirty.clear();
+}
+
+/**
+ * @brief Draws the vectors and heatmap based on the current Frame. Only cells that changed since
+ * the last paint are re-rasterized; the rest comes from the cached texture.
+ */
+void DisplayWidget::draw(){
+    PROFILE_SCOPE("draw");
+
+	// Determine drawing box coordinates.
+	float minx = range_x * MARGIN;
+	float maxx = range_x * (1 - MARGIN);
+	float miny = range_y * MARGIN;
+	float maxy = range_y * (1 - MARGIN);
+	
+	// Check that the vector field has been set.
+	if(!frame)
+		return;
+
+	render();
+
+	// Draw the heat map.
+	glEnable(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, _texture);
+	qglColor(Qt::white);
+	glBegin(GL_QUADS);
+		glTexCoord2f(0, 0); glVertex2f(minx, miny);
+		glTexCoord2f(0, 1); glVertex2f(minx, maxy);
+		glTexCoord2f(1, 1); glVertex2f(maxx, maxy);
+		glTexCoord2f(1, 0); glVertex2f(maxx, miny);
+	glEnd();
+	glDisable(GL_TEXTURE_2D);
 	
 	// Draw the vectors.
 	if(_drawVectors) {
-		i = 0;
-		qglColor(Qt::black);
-		for(int xi = 0;xi < frame->width;xi++){
-			for(int yi = 0;yi < frame->height;yi++){
-				float x = minx + stepx  * xi + stepx / 2;
-				float y = miny + stepy  * yi + stepy / 2;
-				float len = lengths[i];
-
-				if(!frame->getBarrier(yi, xi)){
-					// If there's not a barrier here, draw the vector.
-					arrow(x, y, scale * frame->ux.at(i) / len, scale * frame->uy.at(i) / len);
+		int bands = (frame->width + VECTOR_BAND - 1) / VECTOR_BAND;
+		if(_vectorBands != bands) {
+			if(_vectorLists)
+				glDeleteLists(_vectorLists, _vectorBands);
+			_vectorLists = glGenLists(bands);
+			_vectorBands = bands;
+			_vectorsDirty.assign(bands, true);
+		}
+
+		// Determine the step size of the grid.
+		float stepx = (maxx - minx) / frame->width;
+		float stepy = (maxy - miny) / frame->height;
+
+		// Scale of vectors.
+		float scale = stepx / 3;
+
+		for(int band = 0;band < bands;band++){
+			if(_vectorsDirty[band]) {
+				glNewList(_vectorLists + band, GL_COMPILE);
+				qglColor(Qt::black);
+				int last = std::min((band + 1) * VECTOR_BAND, frame->width);
+				for(int xi = band * VECTOR_BAND;xi < last;xi++){
+					for(int yi = 0;yi < frame->height;yi++){
+						float x = minx + stepx  * xi + stepx / 2;
+						float y = miny + stepy  * yi + stepy / 2;
+						float u = frame->ux()(yi, xi);
+						float v = frame->uy()(yi, xi);
+						float len = std::sqrt(u*u + v*v);
+
+						if(!frame->getBarrier(yi, xi)){
+							// If there's not a barrier here, draw the vector.
+							arrow(x, y, scale * u / len, scale * v / len);
+						}
+					}
 				}
-				i++;
+				glEndList();
+				_vectorsDirty[band] = false;
 			}
+
+			glCallList(_vectorLists + band);
 		}
 	}
 }
 
 /**
- * @brief Sets a new frame.
+ * @brief Sets a new frame. Nothing is re-rasterized if it has the id of the current one.
  * @param frame
  */
 void DisplayWidget::setData(const Frame& frame){
+    TRACE_SCOPE("setData");
     auto oldFrame = this->frame;
     this->frame = frame;
     if(!oldFrame || oldFrame->height != frame.height || oldFrame->width != frame.width) {
         resizeGL(width(), height());
         interactionMode = NONE;
+        invalidate();
+    } else if(frame.id != _frameId) {
+        invalidate();
     }
 
     if(interactionMode == HOVER) {
@@ -495,12 +564,66 @@ void DisplayWidget::setData(const Frame& frame){
     }
 }
 
+/**
+ * @brief Marks the whole frame for redrawing, including its color range.
+ */
+void DisplayWidget::invalidate() {
+    if(!frame)
+        return;
+
+    _frameId = frame->id;
+    _pixels.resize(4 * frame->height * frame->width);
+    updateRange();
+    _dirty.assign(1, QRect(0, 0, frame->width, frame->height));
+    _vectorsDirty.assign(_vectorsDirty.size(), true);
+}
+
+/**
+ * @brief Marks a rectangle of cells for redrawing, and unless vectors is false the arrows of the
+ * column bands it touches.
+ */
+void DisplayWidget::invalidate(int row, int col, int height, int width, bool vectors) {
+    if(!frame)
+        return;
+
+    QRect rect = QRect(col, row, width, height) & QRect(0, 0, frame->width, frame->height);
+    if(rect.isEmpty())
+        return;
+
+    // Many small rectangles cost more in uploads than they save; fall back to their bounds.
+    static constexpr std::size_t MAX_DIRTY = 32;
+    if(_dirty.size() >= MAX_DIRTY) {
+        for(const QRect& r : _dirty)
+            rect |= r;
+        _dirty.clear();
+    }
+    _dirty.push_back(rect);
+
+    if(vectors) {
+        int last = std::min<int>(rect.right() / VECTOR_BAND, (int)_vectorsDirty.size() - 1);
+        for(int band = rect.left() / VECTOR_BAND;band <= last;band++)
+            _vectorsDirty[band] = true;
+    }
+}
+
+/**
+ * @brief The cells covered by the selection being dragged, or an empty rectangle.
+ */
+QRect DisplayWidget::selection() const {
+    if(interactionMode != SELECT)
+        return QRect();
+
+    return QRect(QPoint(std::min({cur_col, start_col}), std::min({cur_row, start_row})),
+                 QPoint(std::max({cur_col, start_col}), std::max({cur_row, start_row})));
+}
+
 /**
  * @brief Disables or enables the drawing of vectors.
  * @param b
  */
 void DisplayWidget::setDrawVectors(bool b) {
 	_drawVectors = b;
+	_vectorsDirty.assign(_vectorsDirty.size(), true);
 	update();
 }
 
@@ -509,5 +632,8 @@ void DisplayWidget::setDrawVectors(bool b) {
  * @param t
  */
 void DisplayWidget::setHeatmapType(HeatmapType t) {
-    heatmapType = t;
+    if(heatmapType != t) {
+        heatmapType = t;
+        invalidate();
+    }
 }
@@ -11,6 +11,9 @@
 
 #include <boost/optional.hpp>
 
+#include <cstdint>
+#include <vector>
+
 /**
  * Widget that draws the vector field.
  */
@@ -44,6 +47,31 @@ class DisplayWidget : public QGLWidget {
     int prev_frame_rows = -1;
     int prev_frame_cols = -1;
 
+    // Heatmap of the current frame, one RGBA pixel per cell, kept between paints and mirrored in
+    // _texture. Only the cells in _dirty (x = col, y = row) are re-rasterized and re-uploaded.
+    std::vector<unsigned char> _pixels;
+    std::vector<QRect> _dirty;
+    GLuint _texture = 0;
+    int _textureRows = 0;
+    int _textureCols = 0;
+
+    // Id of the frame the cached heatmap and color range belong to.
+    std::uint64_t _frameId = 0;
+    float _minValue = 0;
+    float _maxValue = 0;
+
+    // Display lists holding the arrows, one per band of VECTOR_BAND columns; only the bands
+    // whose cells changed are recompiled.
+    static constexpr int VECTOR_BAND = 16;
+    GLuint _vectorLists = 0;
+    int _vectorBands = 0;
+    std::vector<bool> _vectorsDirty;
+
+    QRect selection() const;
+    void updateRange();
+    void rasterize(const QRect& rect);
+    void render();
+
 public:
     enum HeatmapType {DENSITY, SPEED, X_VEL, Y_VEL} heatmapType = SPEED;
 
@@ -58,6 +86,7 @@ protected:
 public:
 
 	DisplayWidget(QWidget* parent = nullptr);
+	~DisplayWidget();
 
 	int getRow(int pixel);
 	int getCol(int pixel);
@@ -96,6 +125,14 @@ public:
 	 * @param frame	the data to draw
 	 */
 	void setData(const Frame& frame);
+
+	/**
+	 * Marks cells whose barriers changed without the frame id changing, so they are redrawn on
+	 * the next paint. Without arguments, the whole frame is redrawn. Pass vectors = false if
+	 * only the heatmap changed, e.g. the selection highlight, so the arrows are kept.
+	 */
+	void invalidate();
+	void invalidate(int row, int col, int height, int width, bool vectors = true);
 	void setDrawVectors(bool);
     void setHeatmapType(HeatmapType t);
 
@@ -103,6 +140,7 @@ signals:
     void hover(QString);
     void selected(int x, int y, int w, int h);
     void toggle(int row, int col);
+    void drag(int row, int col);
 };
 
 #endif // DISPLAYWIDGET_HPP
@@ -0,0 +1,796 @@
+#include "MainWindow.hpp"
+#include "Geometry.hpp"
+#include "NewDialog.hpp"
+#include "Profiler.hpp"
+#include "Tracer.hpp"
+
+#include <QAction>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QCheckBox>
+#include <QComboBox>
+#include <QFileDialog>
+#include <QFormLayout>
+#include <QImage>
+#include <QInputDialog>
+#include <QKeySequence>
+#include <QMenuBar>
+#include <QMouseEvent>
+#include <QPushButton>
+#include <QSizePolicy>
+#include <QSplitter>
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <thread>
+
+#include <QDebug>
+
+// Steps between residual samples when stopping at steady state.
+static constexpr int CONVERGENCE_INTERVAL = 10;
+
+MainWindow::MainWindow(QWidget* parent) : QMainWindow(parent) {
+    QFont font("Monospace");
+    font.setStyleHint(QFont::TypeWriter);
+    statusBar()->setFont(font);
+
+    Tracer::instance().setThreadName("gui");
+
+    _timingLabel = new QLabel;
+    statusBar()->addPermanentWidget(_timingLabel);
+
+	setupMenu();
+	setupUI();
+    setWindowTitle(tr("Vizualizer"));
+}
+
+/**
+ * @brief Sets a new frame.
+ *
+ * @param frameNum	the frame number
+ * @param display	false to only move to the frame without drawing it
+ */
+void MainWindow::setFrame(int frameNum, bool display){
+    TRACE_SCOPE("setFrame");
+
+	if(frameNum > 0) {
+		_mode = RUN;
+	}
+
+    // Generate frames if we don't have enough.
+    while(frameNum >= _state->numFrames()) {
+        if(_state) {
+			_state->step();
+			_state->captureFrame();
+        } else {
+			return;
+        }
+	}
+
+    if(_checkpointer) {
+        _checkpointer->update(*_state);
+    }
+
+	_curFrame = frameNum;
+    _slider->setMaximum(_state->numFrames());
+	_slider->setValue(_curFrame + 1);
+
+    if(!display)
+        return;
+
+    publishFrame(frameNum);
+
+    _displayWidget->setData(_state->getFrame(frameNum));
+
+    _displayWidget->updateGL();
+    updateSubdisplay();
+
+    if(!_state->residuals().empty()) {
+        _residualLabel->setText(QString::number(_state->residuals().back().value, 'e', 3));
+    }
+
+    updateTimings();
+}
+
+/**
+ * @brief Shows the latest step and draw timings next to the hover readout.
+ */
+void MainWindow::updateTimings() {
+    auto step = Profiler::instance().stats("step");
+    auto draw = Profiler::instance().stats("draw");
+
+    if(step.count == 0)
+        return;
+
+    _timingLabel->setText(QString("step %1 ms (p99 %2) %3 MLUPS | draw %4 ms | skip %5")
+                          .arg(step.mean, 0, 'f', 2)
+                          .arg(step.p99, 0, 'f', 2)
+                          .arg(step.mlups, 0, 'f', 1)
+                          .arg(draw.mean, 0, 'f', 2)
+                          .arg(_scheduler.skip()));
+}
+
+/**
+ * @brief Sets a new SimState an resets the state of MainWindow for a new state.
+ * @param s new SimState
+ */
+void MainWindow::setState(SimState s) {
+	_play = false;
+	_playTimer.stop();
+    _scheduler.reset();
+
+    _curFrame = 0;
+
+	_slider->setMaximum(1);
+	_slider->setMinimum(0);
+	_slider->setSliderPosition(_slider->maximum());
+
+	_mode = EDIT;
+	_saveInitialAction->setEnabled(true);
+    _importImageAction->setEnabled(true);
+    _saveCheckpointAction->setEnabled(true);
+
+    _subdisplayWidget->hide();
+
+    _state = s;
+    // Frames are taken once per playback tick, see playEvent().
+    _state->setCapturePolicy(SimState::ON_DEMAND);
+    applyConvergence();
+    _residualLabel->setText("-");
+	setFrame(0);
+}
+
+/**
+ * @brief Passes the steady-state settings from the controls to the current state.
+ */
+void MainWindow::applyConvergence() {
+    if(!_state)
+        return;
+
+    bool ok;
+    double tolerance = _toleranceEdit->text().toDouble(&ok);
+    if(_steadyCheckbox->isChecked() && ok && tolerance > 0) {
+        _state->setConvergence(CONVERGENCE_INTERVAL, tolerance);
+    } else {
+        _state->setConvergence(0, tolerance);
+    }
+}
+
+/**
+ * @brief Creates the widget that holds controls on the right
+ * @param parent    parent widget
+ * @return the initialized config widget
+ */
+QWidget* MainWindow::setupConfigWidget(QWidget* parent) {
+    auto formLayout = new QFormLayout;
+    formLayout->setFieldGrowthPolicy(QFormLayout::AllNonFixedFieldsGrow);
+    formLayout->setSizeConstraint(QLayout::SetNoConstraint);
+
+	auto vectorCheckbox = new QCheckBox();
+	vectorCheckbox->setChecked(true);
+	connect(vectorCheckbox, SIGNAL(toggled(bool)),
+			this, SLOT(vectorToggled(bool)));
+
+    auto heatmapComboBox = new QComboBox();
+    heatmapComboBox->addItems(QStringList{"Density", "Speed", "X Velocity", "Y Velocity"});
+    heatmapComboBox->setCurrentIndex(1);
+    connect(heatmapComboBox, SIGNAL(currentIndexChanged(QString)), this, SLOT(heatmapChanged(QString)));
+
+
+    _subdisplayWidget = new DisplayWidget;
+    _subdisplayWidget->hide();
+    connect(_subdisplayWidget, SIGNAL(hover(QString)), this, SLOT(displayHover(QString)));
+
+    _steadyCheckbox = new QCheckBox();
+    _steadyCheckbox->setChecked(false);
+    connect(_steadyCheckbox, SIGNAL(toggled(bool)), this, SLOT(steadyStateChanged()));
+
+    _toleranceEdit = new QLineEdit("1e-6");
+    _toleranceEdit->setAlignment(Qt::AlignRight);
+    connect(_toleranceEdit, SIGNAL(editingFinished()), this, SLOT(steadyStateChanged()));
+
+    _residualLabel = new QLabel("-");
+
+    _brushSpin = new QSpinBox();
+    _brushSpin->setRange(0, 100);
+    _brushSpin->setSuffix(" cells");
+
+    _playbackComboBox = new QComboBox();
+    _playbackComboBox->addItems(QStringList{"Smooth Display", "Max Throughput"});
+    connect(_playbackComboBox, SIGNAL(currentIndexChanged(int)), this, SLOT(playbackChanged()));
+
+    _fpsSpin = new QSpinBox();
+    _fpsSpin->setRange(1, 120);
+    _fpsSpin->setValue(_scheduler.targetFps());
+    _fpsSpin->setSuffix(" fps");
+    connect(_fpsSpin, SIGNAL(valueChanged(int)), this, SLOT(playbackChanged()));
+
+	formLayout->addRow("Show Vectors:", vectorCheckbox);
+    formLayout->addRow("Heatmap:", heatmapComboBox);
+    formLayout->addRow("Brush Radius:", _brushSpin);
+    formLayout->addRow("Playback:", _playbackComboBox);
+    formLayout->addRow("Target Frame Rate:", _fpsSpin);
+    formLayout->addRow("Stop at Steady State:", _steadyCheckbox);
+    formLayout->addRow("Tolerance:", _toleranceEdit);
+    formLayout->addRow("Residual:", _residualLabel);
+
+    auto vbox = new QVBoxLayout;
+    vbox->addLayout(formLayout, 0);
+    vbox->addWidget(_subdisplayWidget, 1);
+
+	auto configWidget = new QWidget(parent);
+    configWidget->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+    configWidget->setLayout(vbox);
+	return configWidget;
+}
+
+/**
+ * @brief Adds items to menu and connects slots to handle them.
+ */
+void MainWindow::setupMenu(){
+	auto menuBar = this->menuBar();
+	
+	QAction* exitAction = new QAction(tr("&Quit"), this);
+	exitAction->setShortcuts(QKeySequence::Quit);
+	exitAction->setStatusTip(tr("Exit application"));
+	connect(exitAction, SIGNAL(triggered()), this, SLOT(close()));
+
+    QAction* newAction = new QAction(tr("&New"), this);
+	connect(newAction, SIGNAL(triggered()), this, SLOT(newTriggered()));
+
+    _editAction = new QAction(tr("&Edit"), this);
+	connect(_editAction, SIGNAL(triggered()), this, SLOT(editTriggered()));
+    _editAction->setEnabled(false);
+
+    _saveInitialAction = new QAction(tr("Save Initial State"), this);
+    connect(_saveInitialAction, SIGNAL(triggered()), this, SLOT(saveInitialTriggered()));
+    _saveInitialAction->setEnabled(false);
+
+    QAction* loadInitialAction = new QAction(tr("Load Initial State"), this);
+    connect(loadInitialAction, SIGNAL(triggered()), this, SLOT(loadInitialTriggered()));
+
+    _importImageAction = new QAction(tr("Import Barrier Image..."), this);
+    connect(_importImageAction, SIGNAL(triggered()), this, SLOT(importImageTriggered()));
+    _importImageAction->setEnabled(false);
+
+    _saveCheckpointAction = new QAction(tr("Save Checkpoint..."), this);
+    connect(_saveCheckpointAction, SIGNAL(triggered()), this, SLOT(saveCheckpointTriggered()));
+    _saveCheckpointAction->setEnabled(false);
+
+    // Checkpoints use the .istate format, so resuming is the same as loading.
+    QAction* resumeAction = new QAction(tr("Resume from Checkpoint..."), this);
+    connect(resumeAction, SIGNAL(triggered()), this, SLOT(loadInitialTriggered()));
+
+    QAction* autoCheckpointAction = new QAction(tr("Auto Checkpoint..."), this);
+    connect(autoCheckpointAction, SIGNAL(triggered()), this, SLOT(autoCheckpointTriggered()));
+
+    QAction* serveAction = new QAction(tr("Serve Frames..."), this);
+    connect(serveAction, SIGNAL(triggered()), this, SLOT(serveTriggered()));
+
+    QAction* exportTimingsAction = new QAction(tr("Export Timings..."), this);
+    connect(exportTimingsAction, SIGNAL(triggered()), this, SLOT(exportTimingsTriggered()));
+
+    QAction* recordTraceAction = new QAction(tr("Record Trace"), this);
+    recordTraceAction->setCheckable(true);
+    connect(recordTraceAction, SIGNAL(toggled(bool)), this, SLOT(recordTraceToggled(bool)));
+
+    QAction* saveTraceAction = new QAction(tr("Save Trace..."), this);
+    connect(saveTraceAction, SIGNAL(triggered()), this, SLOT(saveTraceTriggered()));
+
+	auto fileMenu = menuBar->addMenu(tr("&File"));
+	fileMenu->addAction(newAction);
+	fileMenu->addAction(_editAction);
+	fileMenu->addAction(_saveInitialAction);
+    fileMenu->addAction(loadInitialAction);
+    fileMenu->addAction(_importImageAction);
+	fileMenu->addSeparator();
+    fileMenu->addAction(_saveCheckpointAction);
+    fileMenu->addAction(resumeAction);
+    fileMenu->addAction(autoCheckpointAction);
+	fileMenu->addSeparator();
+    fileMenu->addAction(serveAction);
+    fileMenu->addAction(exportTimingsAction);
+    fileMenu->addAction(recordTraceAction);
+    fileMenu->addAction(saveTraceAction);
+	fileMenu->addSeparator();
+	fileMenu->addAction(exitAction);
+}
+
+/**
+ * @brief Sets up widget hierarchy and connects slots.
+ */
+void MainWindow::setupUI(){
+	// Create slider and attach handler.
+	_slider = new QSlider(Qt::Horizontal);
+	_slider->setMaximum(1);
+	_slider->setMinimum(0);
+	_slider->setSliderPosition(_slider->maximum());
+	connect(_slider, SIGNAL(sliderMoved(int)), this, SLOT(sliderMoved(int)));
+
+	auto splitterWidget = new QSplitter();
+	_displayWidget = new DisplayWidget(splitterWidget);
+	_configWidget = setupConfigWidget(splitterWidget);
+	splitterWidget->setStretchFactor(0,1);
+	splitterWidget->setStretchFactor(1,0);
+
+	// Create buttons and attach handlers.
+	auto playButton = new QPushButton("Play");
+	connect(playButton, SIGNAL(released()),
+			this, SLOT(playReleased()));
+	auto pauseButton = new QPushButton("Pause");
+	connect(pauseButton, SIGNAL(released()),
+			this, SLOT(pauseReleased()));
+
+	auto sliderHBox = new QHBoxLayout();
+	sliderHBox->addWidget(_slider);
+
+	auto buttonHBox = new QHBoxLayout();
+	buttonHBox->addWidget(playButton);
+	buttonHBox->addWidget(pauseButton);
+
+	auto vbox = new QVBoxLayout();
+	vbox->addWidget(splitterWidget);
+	vbox->addLayout(sliderHBox);
+	vbox->addLayout(buttonHBox);
+
+	// Connect the play timer to the play event handler. The handler is called every time the
+	// timer fires.
+	connect(&_playTimer, SIGNAL(timeout()),
+			this, SLOT(playEvent()));
+
+	// Connect mouse press event from display widget to this object so we can add barriers
+    // when the user clicks.
+    connect(_displayWidget, SIGNAL(hover(QString)),
+            this, SLOT(displayHover(QString)));
+    connect(_displayWidget, SIGNAL(selected(int,int,int,int)),
+            this, SLOT(subdiplaySelected(int,int,int,int)));
+    connect(_displayWidget, SIGNAL(toggle(int,int)),
+            this, SLOT(displayToggle(int,int)));
+    connect(_displayWidget, SIGNAL(drag(int,int)),
+            this, SLOT(displayDrag(int,int)));
+
+	auto centralWidget = new QWidget;
+	centralWidget->setLayout(vbox);
+	setCentralWidget(centralWidget);
+}
+
+/**
+ * @brief Updates subdisplay when a new frame is set.
+ */
+void MainWindow::updateSubdisplay() {
+    TRACE_SCOPE("updateSubdisplay");
+
+    if(_subdisplayWidget->isHidden())
+        return;
+
+    static Frame f = _state->getFrame(_curFrame).getSubframe(subdisplayRow, subdisplayCol, subdisplayH, subdisplayW);
+    f = _state->getFrame(_curFrame).getSubframe(subdisplayRow, subdisplayCol, subdisplayH, subdisplayW);
+    _subdisplayWidget->setData(f);
+    _subdisplayWidget->update();
+}
+
+/**
+ * @brief Called by DisplayWidget instances to show raw data.
+ * @param raw data string
+ */
+void MainWindow::displayHover(QString s) {
+    statusBar()->showMessage(s);
+}
+
+/**
+ * @brief Called by DisplayWidget when a barrier is clicked. Starts a brush stroke that adds
+ * barriers if the clicked cell was fluid and removes them otherwise.
+ * @param row
+ * @param col
+ */
+void MainWindow::displayToggle(int row, int col) {
+    // Click was not in grid.
+    if(row < 0 || col < 0 || !_state)
+        return;
+
+    _paintValue = !_state->getBarrier(row, col);
+    paint(row, col);
+}
+
+/**
+ * @brief Called by DisplayWidget when the mouse is dragged to a new cell during a stroke.
+ * @param row
+ * @param col
+ */
+void MainWindow::displayDrag(int row, int col) {
+    if(row < 0 || col < 0 || !_state)
+        return;
+
+    paint(row, col);
+}
+
+/**
+ * @brief Applies one brush dab centered on a cell, then repaints once.
+ */
+void MainWindow::paint(int row, int col) {
+    // Only the latest frame can be edited; it is where the simulation continues from.
+    if(_curFrame != _state->numFrames() - 1)
+        return;
+
+    int radius = _brushSpin->value();
+    if(radius == 0) {
+        _state->setBarrier(_paintValue, row, col);
+    } else {
+        auto& ux = _state->ux();
+        _state->setBarriers(Shape::circle(radius).cells(ux.n_rows, ux.n_cols, col, row), _paintValue);
+    }
+
+    // Editing a running state gives its latest frame a new barrier array, but its id is unchanged,
+    // so the display has to be told which cells to redraw.
+    _displayWidget->setData(_state->getFrame(_curFrame));
+    _displayWidget->invalidate(row - radius, col - radius, 2 * radius + 1, 2 * radius + 1);
+    _displayWidget->update();
+    updateSubdisplay();
+}
+
+/**
+ * @brief Called when Auto Checkpoint is clicked in menu. Asks for a directory and interval.
+ */
+void MainWindow::autoCheckpointTriggered() {
+    QString dir = QFileDialog::getExistingDirectory(this, tr("Checkpoint Directory"));
+    if(dir.isEmpty())
+        return;
+
+    bool ok;
+    int interval = QInputDialog::getInt(this, tr("Auto Checkpoint"), tr("Steps between checkpoints:"),
+                                        1000, 0, 100000000, 100, &ok);
+    if(!ok)
+        return;
+
+    _checkpointer.reset(new Checkpointer(dir.toStdString(), interval));
+}
+
+/**
+ * @brief Sends a frame to remote viewers, if any are connected and the frame rate cap allows.
+ */
+void MainWindow::publishFrame(int frameNum) {
+    if(_frameServer && _frameServer->wants()) {
+        _frameServer->publish(frameNum, _state->getFrame(frameNum));
+    }
+}
+
+/**
+ * @brief Called when Serve Frames is clicked in menu. Starts, moves or stops the frame server.
+ */
+void MainWindow::serveTriggered() {
+    bool ok;
+    int port = QInputDialog::getInt(this, tr("Serve Frames"), tr("Port on localhost (0 to stop):"),
+                                    _frameServer ? _frameServer->port() : 5555, 0, 65535, 1, &ok);
+    if(!ok)
+        return;
+
+    _frameServer.reset();
+    if(port == 0) {
+        statusBar()->showMessage(tr("Stopped serving frames"));
+        return;
+    }
+
+    _frameServer.reset(new FrameServer);
+    if(_frameServer->start(port)) {
+        statusBar()->showMessage(tr("Serving frames on 127.0.0.1:%1").arg(port));
+    } else {
+        _frameServer.reset();
+        statusBar()->showMessage(tr("Cannot listen on port %1").arg(port));
+    }
+}
+
+/**
+ * @brief Called when the Edit menu option is clicked.
+ */
+void MainWindow::editTriggered() {
+    setState(_state->initialState());
+}
+
+/**
+ * @brief Called when Export Timings is clicked in menu. Writes the recent timing samples the
+ * profiler keeps, see Profiler::HISTORY.
+ */
+void MainWindow::exportTimingsTriggered() {
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Export Timings"),
+                                                    "",
+                                                    tr("CSV (*.csv);;JSON (*.json)"));
+    if(fileName.isEmpty())
+        return;
+
+    std::string path = fileName.toStdString();
+    bool ok = fileName.endsWith(".json") ? Profiler::instance().writeJson(path)
+                                         : Profiler::instance().writeCsv(path);
+    if(!ok) {
+        statusBar()->showMessage(tr("Could not write %1").arg(fileName));
+    }
+}
+
+/**
+ * @brief Called when heatmap dropdown is changed
+ * @param value of heatmap dropdown
+ */
+void MainWindow::heatmapChanged(QString s) {
+    if(s == "Density") {
+        _displayWidget->setHeatmapType(DisplayWidget::HeatmapType::DENSITY);
+        _subdisplayWidget->setHeatmapType(DisplayWidget::HeatmapType::DENSITY);
+    } else if(s == "Speed") {
+        _displayWidget->setHeatmapType(DisplayWidget::HeatmapType::SPEED);
+        _subdisplayWidget->setHeatmapType(DisplayWidget::HeatmapType::SPEED);
+    } else if(s == "X Velocity") {
+        _displayWidget->setHeatmapType(DisplayWidget::HeatmapType::X_VEL);
+        _subdisplayWidget->setHeatmapType(DisplayWidget::HeatmapType::X_VEL);
+    } else if(s == "Y Velocity") {
+        _displayWidget->setHeatmapType(DisplayWidget::HeatmapType::Y_VEL);
+        _subdisplayWidget->setHeatmapType(DisplayWidget::HeatmapType::Y_VEL);
+    }
+
+    _displayWidget->update();
+    _subdisplayWidget->update();
+}
+
+/**
+ * @brief Called when Import Barrier Image is clicked in menu. Dark pixels of the image, stretched
+ * over the whole grid, become barriers.
+ */
+void MainWindow::importImageTriggered() {
+    QString fileName = QFileDialog::getOpenFileName(this,
+                                                    tr("Import Barrier Image"),
+                                                    "",
+                                                    tr("Images (*.png *.bmp *.pbm *.pgm *.jpg)"));
+    QImage image;
+    if(fileName.isEmpty() || !_state || !image.load(fileName))
+        return;
+
+    QImage rgb = image.convertToFormat(QImage::Format_RGB32);
+    std::vector<bool> pixels(rgb.width() * rgb.height());
+    for(int y = 0;y < rgb.height();y++) {
+        auto line = reinterpret_cast<const QRgb*>(rgb.constScanLine(y));
+        for(int x = 0;x < rgb.width();x++) {
+            pixels[y * rgb.width() + x] = qGray(line[x]) < 128;
+        }
+    }
+
+    auto& ux = _state->ux();
+    Geometry geometry(ux.n_rows, ux.n_cols);
+    geometry.image(pixels, image.height(), image.width());
+    _state->setBarriers(geometry.cells(), true);
+
+    _displayWidget->setData(_state->getFrame(_curFrame));
+    _displayWidget->invalidate();
+    _displayWidget->update();
+    updateSubdisplay();
+}
+
+/**
+ * @brief Called when Load is clicked in menu.
+ */
+void MainWindow::loadInitialTriggered() {
+    QString fileName = QFileDialog::getOpenFileName(this,
+                                                    tr("Load Initial State"),
+                                                    "",
+                                                    tr("Initial State (*.istate)"));
+
+    std::ifstream file(fileName.toStdString(), std::ios::binary);
+    if(fileName.isEmpty() || !file)
+        return;
+
+    DataStream stream(file);
+    SimState state = SimState::load(stream);
+    if(stream.ok()) {
+        setState(state);
+    } else {
+        statusBar()->showMessage(tr("%1 is truncated or damaged").arg(fileName));
+    }
+}
+
+/**
+ * @brief Called when New is clicked in menu.
+ */
+void MainWindow::newTriggered() {
+
+	NewDialog* newDialog = new NewDialog();
+    if(newDialog->exec()) {
+        // Hide the subdisplay because a new selection must be made for the new state.
+        _subdisplayWidget->hide();
+
+        SimState s(newDialog->height, newDialog->width);
+        s.setCollisionModel(newDialog->collision);
+        s.setBoundaries(newDialog->inlet, newDialog->outlet);
+        setState(s);
+	}
+    delete newDialog;
+}
+
+/**
+ * @brief Slot called when the pause button is released.
+ */
+void MainWindow::pauseReleased(){
+	_playTimer.stop();
+}
+
+/**
+ * @brief Timer event that skips forward when playing. The scheduler decides how many steps to
+ * take and whether the newest frame is drawn or dropped. Only the last step of a tick is kept
+ * as a frame, so the steps skipped over cost no more than the kernel; frames kept from earlier
+ * ticks are replayed one per tick.
+ */
+void MainWindow::playEvent(){
+    TRACE_SCOPE("playEvent");
+
+	if(!_play)
+		return;
+
+    auto& profiler = Profiler::instance();
+
+    // Step forward, stopping early at steady state.
+    int target = _curFrame + 1;
+    int taken = 0;
+    double start = profiler.now();
+    if(target >= _state->numFrames()) {
+        int steps = _scheduler.steps();
+        while(taken < steps && !_state->converged()) {
+            _state->step();
+            taken++;
+        }
+        _state->captureFrame();
+        publishFrame(_state->numFrames() - 1);
+    }
+    double now = profiler.now();
+    _scheduler.stepped(taken, now - start);
+    target = std::min(target, _state->numFrames() - 1);
+
+    bool converged = _state->converged();
+    if(converged || _scheduler.shouldDraw(now)) {
+        setFrame(target);
+        double end = profiler.now();
+        _scheduler.drawn(end, end - now);
+    } else {
+        setFrame(target, false);
+    }
+
+    if(converged) {
+        _play = false;
+        _playTimer.stop();
+        statusBar()->showMessage(tr("Steady state reached after %1 steps").arg(_state->steps()));
+    }
+}
+
+/**
+ * @brief Slot called when the playback mode or target frame rate changes.
+ */
+void MainWindow::playbackChanged() {
+    _scheduler.setMode(_playbackComboBox->currentIndex() == 0 ? Scheduler::SMOOTH : Scheduler::THROUGHPUT);
+    _scheduler.setTargetFps(_fpsSpin->value());
+
+    if(_playTimer.isActive()) {
+        _playTimer.start(_scheduler.interval());
+    }
+}
+
+/**
+ * @brief Slot called when the play button is released.
+ */
+void MainWindow::playReleased(){
+	if(_state) {
+		_mode = RUN;
+        _editAction->setEnabled(true);
+		_play = true;
+		_playTimer.start(_scheduler.interval());
+	}
+}
+
+/**
+ * @brief Slot called when the "Save Checkpoint" action is triggered. The file is written in the
+ * background so playback keeps going.
+ */
+void MainWindow::saveCheckpointTriggered() {
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Save Checkpoint"),
+                                                    "",
+                                                    tr("Initial State (*.istate)"));
+    if(fileName.isEmpty() || !_state)
+        return;
+
+    if(!_checkpointer) {
+        _checkpointer.reset(new Checkpointer("", 0));
+    }
+    _checkpointer->save(*_state, fileName.toStdString());
+}
+
+/**
+ * @brief Slot called when the "Save Initial State" action is triggered.
+ */
+void MainWindow::saveInitialTriggered() {
+	QString fileName = QFileDialog::getSaveFileName(this,
+													tr("Save Initial State"),
+													"",
+													tr("Initial State (*.istate)"));
+	Q_ASSERT(_mode != STARTED);
+
+    if(fileName.isEmpty())
+        return;
+
+    std::ofstream file(fileName.toStdString(), std::ios::binary);
+    DataStream stream(file);
+    _state->initialState().save(stream);
+    file.close();
+    if(!stream.ok() || !file) {
+        statusBar()->showMessage(tr("Cannot write %1").arg(fileName));
+    }
+
+}
+
+/**
+ * @brief Slot called when "Record Trace" is toggled.
+ */
+void MainWindow::recordTraceToggled(bool checked) {
+    Tracer::instance().setEnabled(checked);
+}
+
+/**
+ * @brief Slot called when "Save Trace" is triggered. Writes a Chrome trace-event file.
+ */
+void MainWindow::saveTraceTriggered() {
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Save Trace"),
+                                                    "",
+                                                    tr("Chrome Trace (*.json)"));
+    if(fileName.isEmpty())
+        return;
+
+    if(!Tracer::instance().write(fileName.toStdString())) {
+        statusBar()->showMessage(tr("Could not write %1").arg(fileName));
+    }
+}
+
+/**
+ * @brief Slot called when slider is moved.
+ * @param val	the value of the slider
+ */
+void MainWindow::sliderMoved(int val) {
+	if(val > 0)
+		setFrame(val - 1);
+}
+
+/**
+ * @brief Slot called when the steady-state checkbox or tolerance is changed.
+ */
+void MainWindow::steadyStateChanged() {
+    applyConvergence();
+}
+
+/**
+ * @brief Called when a subdisplahy is selected in the main DisplayWidget
+ * @param row
+ * @param col
+ * @param height
+ * @param width
+ */
+void MainWindow::subdiplaySelected(int row, int col, int height, int width) {
+    if(row < 0 || col < 0 || height < 2 || width < 2)
+        return;
+
+    subdisplayRow = row;
+    subdisplayCol = col;
+    subdisplayH = height;
+    subdisplayW = width;
+
+    _subdisplayWidget->show();
+    updateSubdisplay();
+    _subdisplayWidget->paintGL();
+    _subdisplayWidget->resize(_subdisplayWidget->size());
+    _subdisplayWidget->resizeGL(_subdisplayWidget->width() - 1, _subdisplayWidget->height());
+    _subdisplayWidget->paintGL();
+}
+
+/**
+ * @brief Slot called when vector checkbox is toggled.
+ */
+void MainWindow::vectorToggled(bool checked) {
+    _displayWidget->setDrawVectors(checked);
+    _subdisplayWidget->setDrawVectors(checked);
+}
@@ -5,20 +5,29 @@
 #ifndef MAIN_WINDOW_HPP
 #define MAIN_WINDOW_HPP
 
+#include "Checkpointer.hpp"
 #include "DisplayWidget.hpp"
 #include "Frame.hpp"
+#include "FrameServer.hpp"
+#include "Scheduler.hpp"
 #include "SimState.hpp"
 
 #include <QMainWindow>
 
+#include <QCheckBox>
+#include <QComboBox>
+#include <QLabel>
+#include <QLineEdit>
 #include <QString>
 #include <QPair>
 #include <QSlider>
+#include <QSpinBox>
 #include <QTimer>
 #include <QWidget>
 
 #include <boost/optional.hpp>
 
+#include <memory>
 #include <vector> // Need std vector because of deleted copy constructor on VecField
 
 #include <boost/optional.hpp>
@@ -38,8 +47,8 @@ class MainWindow : public QMainWindow{
 	// Store the index of the current frame.
 	int _curFrame = 0;
 
-	// Set the number of frames to skip forward when animating.
-    int _skip = 1;
+	// Picks the frames to skip forward and to draw when animating.
+    Scheduler _scheduler;
 
 	/**
 	 * Mode of operation.
@@ -59,6 +68,35 @@ class MainWindow : public QMainWindow{
 
 	QAction* _editAction;
     QAction* _saveInitialAction;
+    QAction* _importImageAction;
+    QAction* _saveCheckpointAction;
+
+    // writes checkpoints in the background, created on first use
+    std::unique_ptr<Checkpointer> _checkpointer;
+
+    // streams frames to remote viewers while set
+    std::unique_ptr<FrameServer> _frameServer;
+    void publishFrame(int frameNum);
+
+    // steady-state detection controls
+    QCheckBox* _steadyCheckbox = nullptr;
+    QLineEdit* _toleranceEdit = nullptr;
+    QLabel* _residualLabel = nullptr;
+
+    // barrier painting: brush radius in cells, and whether the current stroke adds or removes
+    QSpinBox* _brushSpin = nullptr;
+
+    // playback controls
+    QComboBox* _playbackComboBox = nullptr;
+    QSpinBox* _fpsSpin = nullptr;
+    bool _paintValue = true;
+    void paint(int row, int col);
+
+    // permanent status bar readout of the phase timings
+    QLabel* _timingLabel = nullptr;
+    void updateTimings();
+
+    void applyConvergence();
 
 	QWidget* setupConfigWidget(QWidget* parent = nullptr);
 	void setupMenu();
@@ -75,21 +113,31 @@ class MainWindow : public QMainWindow{
 public:
 	MainWindow(QWidget* parent = nullptr);
 
-	void setFrame(int i);
+	void setFrame(int i, bool display = true);
 	void setState(SimState);
 	
 private slots:
     void displayHover(QString);
+    void displayDrag(int row, int col);
     void displayToggle(int row, int col);
+    void autoCheckpointTriggered();
     void editTriggered();
+    void recordTraceToggled(bool checked);
+    void saveTraceTriggered();
+    void exportTimingsTriggered();
     void heatmapChanged(QString s);
+    void importImageTriggered();
     void loadInitialTriggered();
     void newTriggered();
     void playReleased();
     void pauseReleased();
     void playEvent();
+    void playbackChanged();
+    void saveCheckpointTriggered();
     void saveInitialTriggered();
+    void serveTriggered();
     void sliderMoved(int);
+    void steadyStateChanged();
     void subdiplaySelected(int x, int y, int width, int height);
     void vectorToggled(bool checked);
 };
@@ -8,10 +8,25 @@
 
 NewDialog::NewDialog() :
 	heightEdit(new QLineEdit()),
-	widthEdit(new QLineEdit())
+	widthEdit(new QLineEdit()),
+	collisionCombo(new QComboBox()),
+	inletCombo(new QComboBox()),
+	outletCombo(new QComboBox())
 {
 	heightEdit->setAlignment(Qt::AlignRight);
 	widthEdit->setAlignment(Qt::AlignRight);
+	// Same order as SimState::CollisionModel.
+	collisionCombo->addItem("BGK");
+	collisionCombo->addItem("Two relaxation times (TRT)");
+	collisionCombo->addItem("Multiple relaxation times (MRT)");
+	collisionCombo->addItem("Regularized BGK");
+	// Same order as SimState::Inlet and SimState::Outlet.
+	inletCombo->addItem("Forced equilibrium");
+	inletCombo->addItem("Velocity (Zou-He)");
+	inletCombo->addItem("Pressure (Zou-He)");
+	outletCombo->addItem("Periodic");
+	outletCombo->addItem("Zero gradient");
+	outletCombo->addItem("Convective");
 	QFormLayout* formLayout = new QFormLayout(this);
 
 	auto startButton = new QPushButton("Start");
@@ -27,6 +42,9 @@ NewDialog::NewDialog() :
 	connect(cancelButton, SIGNAL(clicked()), this, SLOT(accept()));
 	formLayout->addRow("Height", heightEdit);
 	formLayout->addRow("Width", widthEdit);
+	formLayout->addRow("Collision", collisionCombo);
+	formLayout->addRow("Inlet", inletCombo);
+	formLayout->addRow("Outlet", outletCombo);
 	formLayout->addRow(buttonBox);
 }
 
@@ -45,6 +63,10 @@ void NewDialog::accept() {
 		return;
 	}
 
+	collision = (SimState::CollisionModel)collisionCombo->currentIndex();
+	inlet = (SimState::Inlet)inletCombo->currentIndex();
+	outlet = (SimState::Outlet)outletCombo->currentIndex();
+
 	if(ok) {
 		QDialog::accept();
 	}
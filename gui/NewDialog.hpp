@@ -1,6 +1,9 @@
 #ifndef NEWDIALOG_HPP
 #define NEWDIALOG_HPP
 
+#include "SimState.hpp"
+
+#include <QComboBox>
 #include <QDialog>
 #include <QLineEdit>
 #include <QStatusBar>
@@ -9,12 +12,18 @@ class NewDialog : public QDialog
 {
 	QLineEdit* heightEdit;
 	QLineEdit* widthEdit;
+	QComboBox* collisionCombo;
+	QComboBox* inletCombo;
+	QComboBox* outletCombo;
 
 public:
 	NewDialog();
 
 	int height;
 	int width;
+	SimState::CollisionModel collision;
+	SimState::Inlet inlet;
+	SimState::Outlet outlet;
 
 signals:
 
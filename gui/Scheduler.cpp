@@ -0,0 +1,144 @@
+#include "Scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Weight of the newest measurement in the moving averages.
+static constexpr double SMOOTHING = 0.2;
+
+// Most wall time THROUGHPUT mode lets drawing take.
+static constexpr double DRAW_SHARE = 0.1;
+
+// Bound on the steps of one tick, so a bad estimate cannot freeze the window.
+static constexpr int MAX_STEPS = 10000;
+
+/**
+ * @param fps	display frame rate to aim for
+ * @param mode	whether to favor a steady display or simulation throughput
+ */
+Scheduler::Scheduler(double fps, Mode mode) : _mode(mode), _fps(fps) {
+}
+
+void Scheduler::setMode(Mode mode) {
+	_mode = mode;
+}
+
+Scheduler::Mode Scheduler::mode() const {
+	return _mode;
+}
+
+void Scheduler::setTargetFps(double fps) {
+	_fps = std::max(fps, 1.0);
+}
+
+double Scheduler::targetFps() const {
+	return _fps;
+}
+
+/**
+ * @brief The playback timer interval in milliseconds. THROUGHPUT ticks as soon as the event loop
+ * is idle.
+ */
+int Scheduler::interval() const {
+	return _mode == SMOOTH ? (int)std::lround(1000 / _fps) : 0;
+}
+
+/**
+ * @brief Forgets the measurements, e.g. when a different state is loaded.
+ */
+void Scheduler::reset() {
+	_stepCost = 0;
+	_drawCost = 0;
+	_lastDraw = -1;
+	_skip = 1;
+}
+
+/**
+ * @brief The number of steps to run this tick, at least one.
+ */
+int Scheduler::steps() {
+	if(_stepCost <= 0) {
+		// Nothing measured yet; take one step to learn its cost.
+		_skip = 1;
+		return _skip;
+	}
+
+	double period = 1 / _fps;
+	double budget;
+	if(_mode == SMOOTH) {
+		// Whatever the draw leaves of the period, but at least half of it when drawing cannot
+		// keep up.
+		budget = std::max(period - _drawCost, period / 2);
+	} else {
+		// One period per tick keeps the window responsive between ticks.
+		budget = period;
+	}
+
+	_skip = std::min(std::max((int)(budget / _stepCost), 1), MAX_STEPS);
+	return _skip;
+}
+
+/**
+ * @brief Records how long a tick's steps took. Frames that already existed cost nothing and are
+ * not counted.
+ * @param steps		steps actually taken
+ * @param seconds	wall time they took
+ */
+void Scheduler::stepped(int steps, double seconds) {
+	if(steps <= 0)
+		return;
+
+	double cost = seconds / steps;
+	_stepCost = _stepCost > 0 ? _stepCost + SMOOTHING * (cost - _stepCost) : cost;
+}
+
+/**
+ * @brief Whether the newest frame should be drawn now. When it is not, it is stale by the next
+ * draw and is dropped.
+ * @param now	current time in seconds
+ */
+bool Scheduler::shouldDraw(double now) const {
+	if(_lastDraw < 0)
+		return true;
+
+	double period = 1 / _fps;
+	double elapsed = now - _lastDraw;
+	if(_mode == SMOOTH) {
+		// Allow for timer jitter so every tick draws while the display keeps up. A draw slower
+		// than the period is followed by at least as much stepping.
+		return elapsed >= std::max(0.9 * period, 2 * _drawCost);
+	}
+	return elapsed >= std::max(period, _drawCost / DRAW_SHARE);
+}
+
+/**
+ * @brief Records a draw.
+ * @param now		time the draw finished, in seconds
+ * @param seconds	wall time it took
+ */
+void Scheduler::drawn(double now, double seconds) {
+	// Draws are paced start to start, so the period includes the draw itself.
+	_lastDraw = now - seconds;
+	_drawCost = _drawCost > 0 ? _drawCost + SMOOTHING * (seconds - _drawCost) : seconds;
+}
+
+/**
+ * @brief Steps per tick chosen by the last call to steps().
+ */
+int Scheduler::skip() const {
+	return _skip;
+}
+
+/**
+ * @brief Average wall time of one step in seconds.
+ */
+double Scheduler::stepCost() const {
+	return _stepCost;
+}
+
+/**
+ * @brief Average wall time of one draw in seconds.
+ */
+double Scheduler::drawCost() const {
+	return _drawCost;
+}
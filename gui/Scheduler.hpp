@@ -0,0 +1,50 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+/**
+ * Decides how many simulation steps to run per playback tick and which of the resulting frames
+ * to draw, from the measured cost of a step and of a draw.
+ *
+ * SMOOTH spends one display period per tick: the steps fill what the draw leaves of it, and
+ * every tick draws as long as drawing is faster than the period. THROUGHPUT runs ticks back to
+ * back and only draws when the last draw is at least a period old and drawing stays under a
+ * small share of wall time. Frames that are not drawn are dropped; playback always shows the
+ * newest one, so a slow display never holds the simulation back to its own rate.
+ */
+class Scheduler {
+public:
+	enum Mode {SMOOTH, THROUGHPUT};
+
+private:
+	Mode _mode;
+	double _fps;
+
+	// Exponential moving averages, in seconds.
+	double _stepCost = 0;
+	double _drawCost = 0;
+
+	double _lastDraw = -1;
+	int _skip = 1;
+
+public:
+	Scheduler(double fps = 30, Mode mode = SMOOTH);
+
+	void setMode(Mode mode);
+	Mode mode() const;
+	void setTargetFps(double fps);
+	double targetFps() const;
+
+	int interval() const;
+	void reset();
+
+	int steps();
+	void stepped(int steps, double seconds);
+	bool shouldDraw(double now) const;
+	void drawn(double now, double seconds);
+
+	int skip() const;
+	double stepCost() const;
+	double drawCost() const;
+};
+
+#endif // SCHEDULER_HPP
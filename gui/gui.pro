@@ -0,0 +1,29 @@
+QMAKE_CXXFLAGS += -std=gnu++14 -g -fsanitize=undefined
+
+QMAKE_CXXFLAGS_DEBUG += -pg
+QMAKE_LFLAGS_DEBUG += -pg
+
+INCLUDEPATH += /usr/local/include ../core
+LIBS        += -L$$OUT_PWD/../core -lfluidcore -L/usr/local/libs -lubsan -lrt -lpthread
+PRE_TARGETDEPS += $$OUT_PWD/../core/libfluidcore.a
+
+TEMPLATE = app
+TARGET = vizualizer
+DESTDIR = $$OUT_PWD/..
+DEPENDPATH += . ../core
+INCLUDEPATH += .
+
+#CONFIG += debug
+QT += widgets gui opengl
+
+QMAKE_CXX = clang++
+
+# Input
+SOURCES += main.cpp MainWindow.cpp \
+    NewDialog.cpp \
+    DisplayWidget.cpp \
+    Scheduler.cpp
+HEADERS += MainWindow.hpp \
+    NewDialog.hpp \
+    DisplayWidget.hpp \
+    Scheduler.hpp
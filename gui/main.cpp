@@ -0,0 +1,29 @@
+#include "Headless.hpp"
+#include "MainWindow.hpp"
+
+#include <QApplication>
+#include <QLabel>
+#include <QWidget>
+
+#include <QDebug>
+
+#include <cstring>
+
+int main(int argc, char *argv[ ])
+{
+	// Batch runs must not need a display, so decide before QApplication is created.
+	if(argc > 1 && strcmp(argv[1], "--headless") == 0) {
+		return runHeadless(argc, argv);
+	}
+	if(argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+		return runSweep(argc, argv);
+	}
+	if(argc > 1 && strcmp(argv[1], "--validate") == 0) {
+		return runValidate(argc, argv);
+	}
+
+	QApplication app(argc, argv);
+	auto mainWindow = new MainWindow();
+	mainWindow->show();
+	return app.exec();
+}
@@ -0,0 +1,18 @@
+# vizualizer-headless: --headless and --sweep without linking Qt at all.
+
+QMAKE_CXXFLAGS += -std=gnu++14 -g -fsanitize=undefined
+
+INCLUDEPATH += /usr/local/include ../core
+LIBS        += -L$$OUT_PWD/../core -lfluidcore -L/usr/local/libs -lubsan -lrt -lpthread
+PRE_TARGETDEPS += $$OUT_PWD/../core/libfluidcore.a
+
+TEMPLATE = app
+CONFIG -= qt app_bundle
+CONFIG += console
+TARGET = vizualizer-headless
+DESTDIR = $$OUT_PWD/..
+DEPENDPATH += . ../core
+
+QMAKE_CXX = clang++
+
+SOURCES += main.cpp
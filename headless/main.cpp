@@ -0,0 +1,22 @@
+#include "Headless.hpp"
+
+#include <cstring>
+#include <iostream>
+
+int main(int argc, char *argv[])
+{
+	if(argc > 1 && strcmp(argv[1], "--headless") == 0) {
+		return runHeadless(argc, argv);
+	}
+	if(argc > 1 && strcmp(argv[1], "--sweep") == 0) {
+		return runSweep(argc, argv);
+	}
+	if(argc > 1 && strcmp(argv[1], "--validate") == 0) {
+		return runValidate(argc, argv);
+	}
+
+	std::cerr << "usage: vizualizer-headless --headless <initial.istate> [options]\n"
+			  << "       vizualizer-headless --sweep <geometry.istate> [options]\n"
+			  << "       vizualizer-headless --validate [geometry.istate] [options]\n";
+	return 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * Reference viewer for the frame stream of FrameServer (vizualizer --serve).
+ *
+ * Connects, decodes every message and prints one line per frame. With --ppm, the speed of the
+ * last frame received is also written as an image.
+ *
+ *	c++ -std=c++14 -O2 -I../core frame_client.cpp ../core/FrameCodec.cpp -o frame_client
+ *	./frame_client 127.0.0.1 5555 --frames 100 --ppm last.ppm
+ */
+
+#include "FrameCodec.hpp"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+static void usage() {
+	std::cerr << "usage: frame_client [host] [port] [--frames N] [--ppm FILE]\n";
+}
+
+/**
+ * @brief Reads until a whole message is buffered.
+ * @param size	set to the size of the message at the front of the buffer
+ * @return false if the connection closed first
+ */
+static bool readMessage(int fd, std::vector<std::uint8_t>& buffer, std::size_t& size) {
+	while((size = FrameCodec::messageSize(buffer.data(), buffer.size())) == 0 || buffer.size() < size) {
+		std::uint8_t chunk[65536];
+		ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+		if(n <= 0) {
+			return false;
+		}
+		buffer.insert(buffer.end(), chunk, chunk + n);
+	}
+	return true;
+}
+
+/**
+ * @brief Writes the speed of a frame as a binary PPM, blue to red, barriers gray.
+ */
+static bool writePpm(const QuantizedFrame& frame, const std::string& path) {
+	std::ofstream out(path, std::ios::binary);
+	if(!out) {
+		return false;
+	}
+
+	int cells = frame.height * frame.width;
+	std::vector<float> speed(cells);
+	float max = 0;
+	for(int i = 0;i < cells;i++) {
+		float u = frame.value(QuantizedFrame::UX, i);
+		float v = frame.value(QuantizedFrame::UY, i);
+		speed[i] = std::sqrt(u * u + v * v);
+		max = std::max(max, speed[i]);
+	}
+
+	out << "P6\n" << frame.width << " " << frame.height << "\n255\n";
+	for(int i = 0;i < cells;i++) {
+		unsigned char rgb[3] = {128, 128, 128};
+		if(!frame.barriers[i]) {
+			float n = max > 0 ? speed[i] / max : 0;
+			rgb[0] = 255 * n;
+			rgb[1] = 0;
+			rgb[2] = 255 * (1 - n);
+		}
+		out.write((const char*)rgb, 3);
+	}
+	return (bool)out;
+}
+
+int main(int argc, char* argv[]) {
+	std::string host = "127.0.0.1";
+	int port = 5555;
+	long frames = -1;
+	std::string ppm;
+
+	int positional = 0;
+	for(int i = 1;i < argc;i++) {
+		std::string arg = argv[i];
+		if(arg == "--frames" && i + 1 < argc) {
+			frames = std::atol(argv[++i]);
+		} else if(arg == "--ppm" && i + 1 < argc) {
+			ppm = argv[++i];
+		} else if(arg[0] != '-' && positional == 0) {
+			host = arg;
+			positional++;
+		} else if(arg[0] != '-' && positional == 1) {
+			port = std::atoi(arg.c_str());
+			positional++;
+		} else {
+			usage();
+			return 1;
+		}
+	}
+
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(port);
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(inet_pton(AF_INET, host.c_str(), &addr.sin_addr) != 1 ||
+	   connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+		std::cerr << "cannot connect to " << host << ":" << port << "\n";
+		return 1;
+	}
+
+	std::vector<std::uint8_t> buffer;
+	QuantizedFrame previous;
+	QuantizedFrame frame;
+	bool havePrevious = false;
+	long received = 0;
+
+	while(frames < 0 || received < frames) {
+		std::size_t size;
+		if(!readMessage(fd, buffer, size)) {
+			std::cerr << "connection closed after " << received << " frames\n";
+			break;
+		}
+
+		if(!FrameCodec::decode(buffer.data(), size, havePrevious ? &previous : nullptr, frame)) {
+			std::cerr << "malformed frame\n";
+			close(fd);
+			return 1;
+		}
+		bool key = buffer[9] & FrameCodec::KEY;
+		buffer.erase(buffer.begin(), buffer.begin() + size);
+
+		double sum = 0;
+		int cells = frame.height * frame.width;
+		for(int i = 0;i < cells;i++) {
+			float u = frame.value(QuantizedFrame::UX, i);
+			float v = frame.value(QuantizedFrame::UY, i);
+			sum += std::sqrt(u * u + v * v);
+		}
+
+		std::printf("step %u  %dx%d (1/%d)  %s  %zu bytes (%.2f per cell)  mean speed %.6f\n",
+					frame.step, frame.height, frame.width, frame.factor, key ? "key  " : "delta",
+					size, (double)size / cells, sum / cells);
+
+		std::swap(previous, frame);
+		havePrevious = true;
+		received++;
+	}
+	close(fd);
+
+	if(!ppm.empty() && havePrevious && !writePpm(previous, ppm)) {
+		std::cerr << "cannot write " << ppm << "\n";
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Example consumer of the shared-memory frame ring (vizualizer --headless ... --ring NAME).
+ *
+ * Follows the newest frame, computing the mean speed straight from the shared segment, and
+ * reports frames it skipped or lost to the producer lapping it.
+ *
+ *	c++ -std=c++14 -O2 -I../core ring_reader.cpp ../core/FrameRing.cpp -o ring_reader -lrt
+ *	./ring_reader /lbm --frames 100
+ */
+
+#include "FrameRing.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+int main(int argc, char* argv[]) {
+	std::string name;
+	long frames = -1;
+
+	for(int i = 1;i < argc;i++) {
+		std::string arg = argv[i];
+		if(arg == "--frames" && i + 1 < argc) {
+			frames = std::atol(argv[++i]);
+		} else if(name.empty() && arg[0] != '-') {
+			name = arg;
+		} else {
+			name.clear();
+			break;
+		}
+	}
+	if(name.empty()) {
+		std::cerr << "usage: ring_reader NAME [--frames N]\n";
+		return 1;
+	}
+
+	FrameRingReader reader;
+	while(!reader.open(name)) {
+		// Wait for the producer to create the ring.
+		std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	}
+	std::cout << "ring " << name << ": " << reader.height() << "x" << reader.width()
+			  << ", " << reader.slots() << " slots\n";
+
+	std::size_t cells = (std::size_t)reader.height() * reader.width();
+	std::uint64_t last = 0;
+	long seen = 0;
+	long skipped = 0;
+	long torn = 0;
+
+	while(frames < 0 || seen < frames) {
+		FrameRingReader::View view;
+		if(reader.published() == last || !reader.latest(view)) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		double sum = 0;
+		std::size_t solid = 0;
+		for(std::size_t i = 0;i < cells;i++) {
+			sum += std::sqrt(view.ux[i] * view.ux[i] + view.uy[i] * view.uy[i]);
+			solid += view.barriers[i];
+		}
+
+		// The producer may have reused the slot while we were reading it.
+		if(!reader.valid(view)) {
+			torn++;
+			continue;
+		}
+
+		if(last > 0) {
+			skipped += view.publication - last - 1;
+		}
+		last = view.publication;
+		seen++;
+
+		std::printf("step %llu  mean speed %.6f  solid %zu\n",
+					(unsigned long long)view.step, sum / cells, solid);
+	}
+
+	std::cout << seen << " frames read, " << skipped << " skipped, " << torn << " overwritten while reading\n";
+	return 0;
+}